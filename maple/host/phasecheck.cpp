@@ -0,0 +1,77 @@
+// phasecheck: checks PhaseMath.h against the formulas it replaced.
+//
+// The TimerChannel ISR used to normalize, wrap and align its phases
+// with % and /.  For both timer configurations this runs every input
+// the ISR can hand each helper through the old expression and the new
+// one: offset() over every relative phase from -384 up to the timer
+// count, wrap() over every last phase with every normalized offset and
+// every brightness added, and align() over the whole timer range.
+// Prints the mismatches, if any, and exits non-zero if there are any.
+//
+// usage: phasecheck
+
+#include <stdio.h>
+#include "wirish.h"
+#include "PhaseMath.h"
+
+#define MAX_REPORTED        8
+
+static uint32 mismatches;
+
+static void report(const char *name, uint32 tc, int32 input, int32 was, int32 now)
+{
+    if (mismatches++ < MAX_REPORTED)
+        printf("  %s<%u>(%d): was %d, now %d\n", name, tc, input, was, now);
+}
+
+template <uint32 TC>
+static bool check()
+{
+    mismatches = 0;
+
+    for (int32 relative_phase = -384; relative_phase < (int32)TC; ++relative_phase)
+    {
+        int32 was = ((relative_phase - 128 + 512) % 256) + 128;
+        int32 now = PhaseMath<TC>::offset(relative_phase);
+        if (was != now)
+            report("offset", TC, relative_phase, was, now);
+    }
+
+    for (int32 last_phase = 0; last_phase < (int32)TC; ++last_phase)
+    {
+        for (int32 offset = 128; offset < 384; ++offset)
+        {
+            int32 phase = (offset * PHASE_SCALE_FACTOR) + last_phase;
+            int32 was = phase % (int32)TC;
+            int32 now = PhaseMath<TC>::wrap(phase);
+            if (was != now)
+                report("wrap", TC, phase, was, now);
+        }
+        for (int32 brightness = 0; brightness < 256; ++brightness)
+        {
+            int32 phase = last_phase + brightness;
+            int32 was = phase % (int32)TC;
+            int32 now = PhaseMath<TC>::wrap(phase);
+            if (was != now)
+                report("wrap", TC, phase, was, now);
+        }
+
+        int32 was = last_phase;
+        if ((last_phase % PHASE_COUNT) != 0)
+            was = (((last_phase / PHASE_COUNT) + 1) * PHASE_COUNT) % TC;
+        int32 now = PhaseMath<TC>::align(last_phase);
+        if (was != now)
+            report("align", TC, last_phase, was, now);
+    }
+
+    printf("timer count %u: %u mismatches\n", TC, mismatches);
+    return mismatches == 0;
+}
+
+int main()
+{
+    bool ok = check<TIMER_COUNT_SHOW>();
+    ok = check<TIMER_COUNT_MAINTENANCE>() && ok;
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+// potcheck: checks PotScale.h against the float code it replaced.
+//
+// Runs every sum of POT_SAMPLES 12-bit ADC reads through the old float
+// average and pot_average(), and every 12-bit value through the old
+// float scale() and the integer one, into the BRIGHTNESS and PRESCALE
+// ranges the maintenance pots map to.  Prints the mismatches, if any,
+// and exits non-zero if there are any.
+//
+// usage: potcheck
+
+#include <stdio.h>
+#include "wirish.h"
+#include "PotScale.h"
+
+#define MAX_REPORTED        8
+
+static uint32 mismatches;
+
+static void report(const char *name, uint32 input, int32 was, int32 now)
+{
+    if (mismatches++ < MAX_REPORTED)
+        printf("  %s(%u): was %d, now %d\n", name, input, was, now);
+}
+
+// the maintenance pot code as it was, floats and all
+static float float_scale(float x, float in_min, float in_max, float out_min, float out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static int float_average(uint32 sum, int samples)
+{
+    // the old loop added the reads into a float one at a time, which
+    // is exact all the way up to the largest sum
+    float total = sum;
+    return (total / samples);
+}
+
+static void check_range(const char *name, int32 out_min, int32 out_max)
+{
+    for (uint32 x = 0; x <= POT_MAX; ++x)
+    {
+        int32 was = float_scale(x, 0, POT_MAX, out_min, out_max);
+        int32 now = scale(x, 0, POT_MAX, out_min, out_max);
+        if (was != now)
+            report(name, x, was, now);
+    }
+}
+
+int main()
+{
+    for (uint32 sum = 0; sum <= (uint32)POT_MAX * POT_SAMPLES; ++sum)
+    {
+        int32 was = float_average(sum, POT_SAMPLES);
+        int32 now = pot_average(sum, POT_SAMPLES);
+        if (was != now)
+            report("average", sum, was, now);
+    }
+    check_range("brightness", MAX_BRIGHTNESS, MIN_BRIGHTNESS);
+    check_range("prescale", MAX_PRESCALE, MIN_PRESCALE);
+
+    printf("%u mismatches\n", mismatches);
+    bool ok = mismatches == 0;
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
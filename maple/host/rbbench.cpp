@@ -0,0 +1,139 @@
+// rbbench: RingBuffer throughput benchmark.
+//
+// Runs a producer and a consumer thread against one RingBuffer, the way
+// the main loop and a timer ISR share it on the Maple, and reports items
+// per second for single and batched push/pop.  The consumer checks that
+// every item comes out in order, so a broken index update shows up as a
+// failure rather than as a suspiciously good number.  Either side yields
+// when it can't make progress, so this also works on a single core.
+//
+// usage: rbbench [items]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "wirish.h"
+#include "RingBuffer.h"
+
+#define DEFAULT_ITEMS   50000000
+#define BENCH_CAPACITY  512
+#define BATCH_SIZE      12
+
+typedef RingBuffer<uint32, BENCH_CAPACITY> bench_buffer_t;
+
+struct bench_t
+{
+    bench_buffer_t          rbuf;
+    uint32                  items;
+    bool                    batch;
+    bool                    ok;
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *producer(void *arg)
+{
+    bench_t *bench = (bench_t *)arg;
+    uint32 next = 0;
+
+    if (bench->batch)
+    {
+        uint32 items[BATCH_SIZE];
+        while (next < bench->items)
+        {
+            uint16 count = min((uint32)BATCH_SIZE, bench->items - next);
+            for (uint16 idx = 0; idx < count; ++idx)
+                items[idx] = next + idx;
+            uint16 pushed = bench->rbuf.push_n(items, count);
+            if (!pushed)
+                sched_yield();
+            next += pushed;
+        }
+    } else
+    {
+        while (next < bench->items)
+        {
+            if (bench->rbuf.try_push(next))
+                next++;
+            else
+                sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    bench_t *bench = (bench_t *)arg;
+    uint32 expected = 0;
+
+    bench->ok = true;
+    if (bench->batch)
+    {
+        uint32 items[BATCH_SIZE];
+        while (expected < bench->items)
+        {
+            uint16 count = bench->rbuf.pop_n(items, BATCH_SIZE);
+            if (!count)
+                sched_yield();
+            for (uint16 idx = 0; idx < count; ++idx)
+            {
+                if (items[idx] != expected++)
+                    bench->ok = false;
+            }
+        }
+    } else
+    {
+        uint32 item;
+        while (expected < bench->items)
+        {
+            if (!bench->rbuf.pop_front(item))
+            {
+                sched_yield();
+                continue;
+            }
+            if (item != expected++)
+                bench->ok = false;
+        }
+    }
+    return NULL;
+}
+
+static bool run(const char *name, uint32 items, bool batch)
+{
+    bench_t bench;
+    pthread_t prod, cons;
+
+    bench.items = items;
+    bench.batch = batch;
+
+    double start = now();
+    pthread_create(&cons, NULL, consumer, &bench);
+    pthread_create(&prod, NULL, producer, &bench);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    double elapsed = now() - start;
+
+    printf("%-10s %10u items %8.3f s %8.2f Mitems/s %s\n", name, items,
+           elapsed, items / elapsed / 1e6, bench.ok ? "ok" : "OUT OF ORDER");
+    return bench.ok;
+}
+
+int main(int argc, char **argv)
+{
+    uint32 items = DEFAULT_ITEMS;
+
+    if (argc > 1)
+        items = strtoul(argv[1], NULL, 0);
+
+    bool ok = run("single", items, false);
+    ok &= run("batch", items, true);
+    return ok ? 0 : 1;
+}
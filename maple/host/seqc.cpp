@@ -0,0 +1,187 @@
+// seqc: the slink sequence compiler.
+//
+// Reads a show sequence as text, one step per line, and optionally the
+// seed for its random numbers (0, the default, draws one at power up):
+//
+//   seed 1234
+//   # mode duration parameters...
+//   0 4 40 0 -1 50 20
+//
+// and writes it as the binary image described in Sequence.h, ready to be
+// stored in the firmware's sequence page.  With -u the image is preceded
+// by the 'u' command, so it can go straight to the board:
+//
+//   seqc -u show.seq > /dev/ttyACM0
+//
+// The board answers with a STATUS_FRAME_SEQUENCE status frame.  Missing
+// parameters are 0, see initMode() for what they mean in each mode.
+// With -d the built in show is written out as text instead, which makes
+// a good starting point.
+//
+// usage: seqc [-u] [file] > image
+//        seqc -d > show.seq
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "wirish.h"
+#include "Animation.h"
+#include "Sequence.h"
+
+#define LINE_SIZE       256
+
+static void dump_default()
+{
+    printf("seed 0\n");
+    printf("# mode duration parameters...\n");
+    for (uint16 idx = 0; idx < animation_count; ++idx)
+    {
+        const animation_info_t *step = &animation_info[idx];
+        printf("%d %d", step->mode_number, step->duration);
+        for (int p = 0; p < MODE_PARAM_COUNT; ++p)
+            printf(" %d", step->param[p]);
+        printf("\n");
+    }
+}
+
+// Parses one line into step, returns false if the line has no step.
+static bool parse_step(char *line, int number, animation_info_t *step, bool *error)
+{
+    char *hash = strchr(line, '#');
+    if (hash)
+        *hash = '\0';
+
+    long value[2 + MODE_PARAM_COUNT] = {};
+    int count = 0;
+    char *text = line;
+    char *end;
+    while (true)
+    {
+        long v = strtol(text, &end, 0);
+        if (end == text)
+            break;
+        if (count == 2 + MODE_PARAM_COUNT)
+        {
+            fprintf(stderr, "line %d: too many values\n", number);
+            *error = true;
+            return false;
+        }
+        value[count++] = v;
+        text = end;
+    }
+    while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n')
+        text++;
+    if (*text)
+    {
+        fprintf(stderr, "line %d: can't read '%s'\n", number, text);
+        *error = true;
+        return false;
+    }
+    if (count == 0)
+        return false;
+    if (count < 2)
+    {
+        fprintf(stderr, "line %d: need a mode and a duration\n", number);
+        *error = true;
+        return false;
+    }
+
+    if (value[0] < 0 || value[0] >= MODE_COUNT || value[1] <= 0 || value[1] > 255)
+    {
+        fprintf(stderr, "line %d: mode must be 0..%d and duration 1..255\n", number, MODE_COUNT - 1);
+        *error = true;
+        return false;
+    }
+    step->mode_number = value[0];
+    step->duration = value[1];
+    for (int p = 0; p < MODE_PARAM_COUNT; ++p)
+    {
+        if (value[2 + p] < -32768 || value[2 + p] > 32767)
+        {
+            fprintf(stderr, "line %d: parameter %d out of range\n", number, p);
+            *error = true;
+            return false;
+        }
+        step->param[p] = value[2 + p];
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool upload = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ud")) != -1)
+    {
+        switch (opt)
+        {
+            case 'u':
+                upload = true;
+                break;
+            case 'd':
+                dump_default();
+                return 0;
+            default:
+                fprintf(stderr, "usage: %s [-u] [file] > image\n       %s -d > show.seq\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+
+    FILE *in = stdin;
+    if (optind < argc && !(in = fopen(argv[optind], "r")))
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    static sequence_t seq;
+    char line[LINE_SIZE];
+    int number = 0;
+    bool error = false;
+    while (fgets(line, sizeof(line), in))
+    {
+        number++;
+        animation_info_t step = {};
+        char *text = line + strspn(line, " \t");
+        if (strncmp(text, "seed", 4) == 0)
+        {
+            char *end;
+            seq.header.seed = strtoul(text + 4, &end, 0);
+            if (end == text + 4 || strspn(end, " \t\r\n") != strlen(end))
+            {
+                fprintf(stderr, "line %d: can't read the seed\n", number);
+                return 1;
+            }
+            continue;
+        }
+        if (!parse_step(line, number, &step, &error))
+        {
+            if (error)
+                return 1;
+            continue;
+        }
+        if (seq.header.count == SEQUENCE_MAX_STEPS)
+        {
+            fprintf(stderr, "line %d: more than %d steps\n", number, SEQUENCE_MAX_STEPS);
+            return 1;
+        }
+        seq.step[seq.header.count++] = step;
+    }
+
+    seq.header.magic = SEQUENCE_MAGIC;
+    seq.header.version = SEQUENCE_VERSION;
+    seq.header.crc = sequence_crc(&seq);
+    if (sequence_check(&seq) != SEQUENCE_OK)
+    {
+        fprintf(stderr, "no steps\n");
+        return 1;
+    }
+
+    if (upload)
+        putchar('u');
+    fwrite(&seq, sequence_size(seq.header.count), 1, stdout);
+    fprintf(stderr, "%u steps, %u bytes\n", seq.header.count, sequence_size(seq.header.count));
+    return 0;
+}
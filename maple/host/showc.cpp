@@ -0,0 +1,199 @@
+// showc: the slink show compiler.
+//
+// Runs the animation engine over animation_info[] on the host and bakes
+// the per-frame phase deltas into a const table that the firmware can
+// stream straight into the TimerChannel queues (build it with
+// -DSHOW_TABLE).  The frames are compressed with the format described in
+// ShowCodec.h and written to stdout as a C header.
+//
+// usage: showc [-s seed] > ../slink/show_table.h
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "wirish.h"
+#include "Animation.h"
+#include "ShowCodec.h"
+
+#define DEFAULT_SEED    1
+
+typedef std::vector<uint8> bytes_t;
+
+// The TimerChannel ISR only ever looks at a delta through
+// ((delta - 128 + 512) % 256) + 128, which lands in [128, 384) for any
+// delta >= -384.  That offset is unique modulo 256, so a single byte per
+// channel, read back as 0..255, reproduces exactly what the ISR would have
+// scheduled.  Small deltas stay small.
+static bool bake_delta(int32 delta, uint8 *baked)
+{
+    int32 next_phase = ((delta - 128 + 512) % 256) + 128;
+    if (next_phase < 128)
+        return false;
+    *baked = next_phase & 0xFF;
+    return true;
+}
+
+static void put_varint(bytes_t &out, uint32 value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+class ShowEncoder
+{
+public:
+    ShowEncoder(bytes_t &out)
+        : _out(out), _have_frame(false), _repeat(0)
+    {}
+
+    void frame(const uint8 *frame)
+    {
+        if (_have_frame && !memcmp(frame, _frame, CHANNEL_COUNT))
+        {
+            _repeat++;
+            return;
+        }
+        flush_repeat();
+
+        bool equal = true;
+        for (int ch = 1; ch < CHANNEL_COUNT; ++ch)
+            equal &= (frame[ch] == frame[0]);
+
+        if (equal)
+        {
+            _out.push_back(SHOW_OP_EQUAL);
+            put_varint(_out, show_zigzag(frame[0]));
+        } else
+        {
+            _out.push_back(SHOW_OP_ROW);
+            for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+                put_varint(_out, show_zigzag(frame[ch]));
+        }
+        memcpy(_frame, frame, CHANNEL_COUNT);
+        _have_frame = true;
+    }
+
+    void step()
+    {
+        flush_repeat();
+        _out.push_back(SHOW_OP_STEP);
+    }
+
+    void end()
+    {
+        flush_repeat();
+        _out.push_back(SHOW_OP_END);
+    }
+
+private:
+    void flush_repeat()
+    {
+        if (!_repeat)
+            return;
+        _out.push_back(SHOW_OP_REPEAT);
+        put_varint(_out, _repeat);
+        _repeat = 0;
+    }
+
+    bytes_t                 &_out;
+    bool                    _have_frame;
+    uint32                  _repeat;
+    uint8                   _frame[CHANNEL_COUNT];
+};
+
+int main(int argc, char **argv)
+{
+    unsigned int seed = DEFAULT_SEED;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    animation_seed(seed);
+    animation_reset();
+
+    bytes_t frames;
+    bytes_t data;
+    ShowEncoder encoder(data);
+    int32 steps = 0;
+
+    do
+    {
+        while (animation_frame())
+        {
+            uint8 frame[CHANNEL_COUNT];
+            for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+            {
+                if (!bake_delta(phase[ch] - previous_phase[ch], frame + ch))
+                {
+                    fprintf(stderr, "step %d frame %d channel %d: delta %d can't be baked\n",
+                            current_animation, timeSoFar - 1, ch, phase[ch] - previous_phase[ch]);
+                    return 1;
+                }
+            }
+            frames.insert(frames.end(), frame, frame + CHANNEL_COUNT);
+            encoder.frame(frame);
+        }
+        encoder.step();
+        steps++;
+    } while (animation_advance());
+    encoder.end();
+
+    // make sure the firmware's decoder gives back exactly what we baked
+    ShowDecoder decoder;
+    size_t offset = 0;
+    int32 decoded_steps = 0;
+    uint8 rec;
+
+    decoder.init(&data[0]);
+    while ((rec = decoder.next()) != SHOW_END)
+    {
+        if (rec == SHOW_STEP)
+        {
+            decoded_steps++;
+            continue;
+        }
+        if (offset >= frames.size() || memcmp(decoder.frame(), &frames[offset], CHANNEL_COUNT))
+        {
+            fprintf(stderr, "decoder mismatch at frame %zu\n", offset / CHANNEL_COUNT);
+            return 1;
+        }
+        offset += CHANNEL_COUNT;
+    }
+    if (offset != frames.size() || decoded_steps != steps)
+    {
+        fprintf(stderr, "decoder stopped short\n");
+        return 1;
+    }
+
+    printf("// Generated by maple/host/showc (seed %u) -- do not edit.\n", seed);
+    printf("#ifndef __SHOW_TABLE_H__\n");
+    printf("#define __SHOW_TABLE_H__\n\n");
+    printf("#define SHOW_STEP_COUNT         %d\n", steps);
+    printf("#define SHOW_FRAME_COUNT        %zu\n\n", frames.size() / CHANNEL_COUNT);
+    printf("// see ShowCodec.h for the format\n");
+    printf("const uint8 show_data[%zu] =\n{", data.size());
+    for (size_t idx = 0; idx < data.size(); ++idx)
+        printf("%s0x%02x,", (idx % 16) ? " " : "\n    ", data[idx]);
+    printf("\n};\n\n");
+    printf("#endif // __SHOW_TABLE_H__\n");
+
+    fprintf(stderr, "%d steps, %zu frames, %zu bytes raw, %zu bytes encoded\n",
+            steps, frames.size() / CHANNEL_COUNT, frames.size(), data.size());
+    return 0;
+}
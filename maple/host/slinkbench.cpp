@@ -0,0 +1,99 @@
+// slinkbench: frame rate benchmark for the slink animation engine.
+//
+// Runs the full animation_info[] show through the same Animation.cpp
+// the firmware uses, as fast as it will go, and reports frames per
+// second, the cost per channel and the cost of a frame in each mode.
+// Each animation step is timed as a whole, so the clock itself stays
+// out of the per-frame numbers.
+//
+// usage: slinkbench [-n shows] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "wirish.h"
+#include "Animation.h"
+
+#define DEFAULT_SHOWS   200
+#define DEFAULT_SEED    1
+#define MAX_MODES       16
+
+typedef struct mode_cost
+{
+    uint64              frames;
+    double              seconds;
+} mode_cost_t;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// keeps the compiler from dropping frames nobody looks at
+static volatile int32 sink;
+
+int main(int argc, char **argv)
+{
+    uint32 shows = DEFAULT_SHOWS;
+    unsigned int seed = DEFAULT_SEED;
+    mode_cost_t modes[MAX_MODES] = {};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                shows = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n shows] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    animation_seed(seed);
+    double start = now();
+    for (uint32 show = 0; show < shows; ++show)
+    {
+        animation_reset();
+        do
+        {
+            int32 mode = current_mode;
+            uint32 frames = 0;
+            double step_start = now();
+            while (animation_frame())
+            {
+                sink = phase[CHANNEL_COUNT - 1];
+                frames++;
+            }
+            modes[mode].seconds += now() - step_start;
+            modes[mode].frames += frames;
+        } while (animation_advance());
+    }
+    double elapsed = now() - start;
+
+    uint64 frames = 0;
+    for (int mode = 0; mode < MAX_MODES; ++mode)
+        frames += modes[mode].frames;
+
+    printf("%u shows, %llu frames in %.3f s\n", shows, (unsigned long long)frames, elapsed);
+    printf("%.0f frames/s, %.1f ns per channel\n\n",
+           frames / elapsed, elapsed * 1e9 / (frames * CHANNEL_COUNT));
+    printf("mode    frames      ns/frame    ns/channel\n");
+    for (int mode = 0; mode < MAX_MODES; ++mode)
+    {
+        if (!modes[mode].frames)
+            continue;
+        double ns = modes[mode].seconds * 1e9 / modes[mode].frames;
+        printf("%-7d %-11llu %-11.1f %.1f\n", mode,
+               (unsigned long long)modes[mode].frames, ns, ns / CHANNEL_COUNT);
+    }
+    return 0;
+}
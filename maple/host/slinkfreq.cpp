@@ -0,0 +1,138 @@
+// slinkfreq: checks the fractional strobe frequency, see PrescaleDither.h.
+//
+// Runs the dither the way the update interrupt does, one prescale a
+// timer period, for every strobe frequency in mHz the prescale range
+// covers, and works out the frequency the periods average to.  Prints
+// the worst error over the sweep after a short run and a long one,
+// next to what the nearest whole prescale would give.
+//
+// It then hands over a new prescale every period, straight after the
+// update interrupt has dithered the next one from the old, as
+// timer_update() does, and checks the periods still average out to
+// what was asked for.
+//
+// Last, frequencies outside the range, down to 0 and up to the largest
+// a uint32 holds, have to come out at the nearest end of the prescale
+// range.
+//
+// usage: slinkfreq [-n periods] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "wirish.h"
+#include "PrescaleDither.h"
+#include "Random.h"
+
+#define DEFAULT_PERIODS     5625        // an hour of the show
+#define SHORT_PERIODS       64
+#define DEFAULT_SEED        1
+#define TOLERANCE_MILLIHZ   1.0
+
+// below and above what the prescale range reaches
+static const uint32 too_low[] = {0, 1, 1000, 1072, 1073};
+static const uint32 too_high[] = {1000000, 0xFFFFFFFF};
+
+// the strobe frequency in mHz that periods averaging this prescale give
+static double millihz(double prescale)
+{
+    return CLOCK_FREQUENCY * 1000.0 / (prescale * PHASE_COUNT);
+}
+
+int main(int argc, char **argv)
+{
+    uint32 periods = DEFAULT_PERIODS;
+    uint32 seed = DEFAULT_SEED;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': periods = strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n periods] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (periods < SHORT_PERIODS)
+        periods = SHORT_PERIODS;
+
+    uint32 lowest = ceil(millihz(MAX_PRESCALE));
+    uint32 highest = floor(millihz(MIN_PRESCALE));
+    double worst_short = 0;
+    double worst_long = 0;
+    double worst_whole = 0;
+
+    for (uint32 target = lowest; target <= highest; ++target)
+    {
+        uint32 prescale_q16 = prescale_q16_from_millihz(target);
+        PrescaleDither dither;
+        uint64 total = 0;
+
+        for (uint32 period = 1; period <= periods; ++period)
+        {
+            total += dither.next(prescale_q16);
+            if (period == SHORT_PERIODS)
+                worst_short = max(worst_short, fabs(millihz((double)total / period) - target));
+        }
+        worst_long = max(worst_long, fabs(millihz((double)total / periods) - target));
+        worst_whole = max(worst_whole, fabs(millihz((prescale_q16 + 0x8000) >> 16) - target));
+    }
+
+    printf("%u to %u mHz, %u periods (%.0f s of the show)\n", lowest, highest, periods,
+           periods * (double)TIMER_COUNT_SHOW * DEFAULT_PRESCALE / CLOCK_FREQUENCY);
+    printf("whole prescale: worst %.3f mHz off\n", worst_whole);
+    printf("dithered: worst %.4f mHz off after %u periods, %.6f mHz after %u\n",
+           worst_short, SHORT_PERIODS, worst_long, periods);
+
+    // a new prescale every period, redone over the one the update
+    // interrupt had dithered from the last.  They are all half way
+    // between two steps, which is where a dither that lost track of
+    // which period it is on would be a long way out.
+    Random random;
+    random.seed(seed);
+    PrescaleDither dither;
+    uint32 prescale_q16 = (uint32)DEFAULT_PRESCALE << 16;
+    uint64 asked = 0;
+    uint64 total = 0;
+    for (uint32 period = 0; period < periods; ++period)
+    {
+        dither.next(prescale_q16);
+        prescale_q16 = ((MIN_PRESCALE + random.below(MAX_PRESCALE - MIN_PRESCALE)) << 16) + 0x8000;
+        asked += prescale_q16;
+        total += dither.redo(prescale_q16);
+    }
+    double handed = millihz((double)asked / 65536 / periods);
+    double retimed = fabs(millihz((double)total / periods) - handed);
+    printf("handed over every period: %.6f mHz off\n", retimed);
+
+    uint32 unclamped = 0;
+    for (uint32 idx = 0; idx < sizeof(too_low) / sizeof(too_low[0]) + 1; ++idx)
+    {
+        uint32 target = (idx < sizeof(too_low) / sizeof(too_low[0])) ? too_low[idx] : lowest - 1;
+        uint32 prescale_q16 = prescale_q16_from_millihz(target);
+        if (prescale_q16 != (uint32)MAX_PRESCALE << 16)
+        {
+            printf("  %u mHz: prescale %.4f, not %u\n", target, prescale_q16 / 65536.0, MAX_PRESCALE);
+            unclamped++;
+        }
+    }
+    for (uint32 idx = 0; idx < sizeof(too_high) / sizeof(too_high[0]) + 1; ++idx)
+    {
+        uint32 target = (idx < sizeof(too_high) / sizeof(too_high[0])) ? too_high[idx] : highest + 1;
+        uint32 prescale_q16 = prescale_q16_from_millihz(target);
+        if (prescale_q16 != (uint32)MIN_PRESCALE << 16)
+        {
+            printf("  %u mHz: prescale %.4f, not %u\n", target, prescale_q16 / 65536.0, MIN_PRESCALE);
+            unclamped++;
+        }
+    }
+    printf("out of range: %u not clamped\n", unclamped);
+
+    bool ok = worst_long < TOLERANCE_MILLIHZ && retimed < TOLERANCE_MILLIHZ && unclamped == 0;
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+// slinklock: model of the closed loop speed lock, see SpeedLock.h.
+//
+// Runs TachCapture and SpeedLock from the firmware against a synthetic
+// tachometer: a rotor whose speed starts off PRESCALE and drifts with
+// the load, with jitter on the index edges, spurious edges and missed
+// ones.  The strobe timer is modelled as it behaves on the board:
+// PRESCALE core cycles a tick, TIMER_COUNT_SHOW ticks a period, and a
+// new prescale only loads at the update event, and is held off past
+// the next one if it is handed over within TIMER_UPDATE_GUARD ticks of
+// it (timer_update()).
+//
+// Prints how long the loop took to lock and how far the index wandered
+// from TACH_PHASE after that.  With -o the loop is left open, at the
+// starting prescale, to show the creep it takes out.  -t writes the
+// loop state once a revolution.
+//
+// usage: slinklock [-o] [-t] [-n revs] [-f hz] [-d drift hz] [-p drift s]
+//                  [-j jitter us] [-g glitches] [-m misses] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "wirish.h"
+#include "SpeedLock.h"
+#include "Random.h"
+
+#define DEFAULT_REVS        6000        // two minutes at 50 Hz
+#define DEFAULT_HZ          50.4
+#define DEFAULT_DRIFT_HZ    0.3
+#define DEFAULT_DRIFT_S     20.0
+#define DEFAULT_JITTER_US   20.0
+#define DEFAULT_GLITCHES    0.01        // spurious edges a revolution
+#define DEFAULT_MISSES      0.01        // missed edges a revolution
+#define DEFAULT_SEED        1
+#define UPDATE_GUARD_TICKS  4           // as TIMER_UPDATE_GUARD
+
+static Random noise;
+
+// 0..1
+static double uniform()
+{
+    return noise.next() / 4294967296.0;
+}
+
+// roughly normal, mean 0 and standard deviation 1
+static double gaussian()
+{
+    double sum = 0;
+    for (int idx = 0; idx < 12; ++idx)
+        sum += uniform();
+    return sum - 6;
+}
+
+// TIMER2 (and 3 and 4, which run in lock step) in core cycles
+class StrobeTimer
+{
+public:
+    StrobeTimer(uint16 prescale)
+        : _update(0), _active(prescale), _pending(prescale), _deferred(0)
+    {}
+
+    // Runs the timer up to cycle t, taking any update events on the way.
+    void run(int64 t)
+    {
+        while (t >= _update + (int64)TIMER_COUNT_SHOW * _active)
+        {
+            _update += (int64)TIMER_COUNT_SHOW * _active;
+            _active = _pending;
+            if (_deferred)
+            {
+                _pending = _deferred;
+                _deferred = 0;
+            }
+        }
+    }
+
+    uint16 count(int64 t)
+    {
+        run(t);
+        return (t - _update) / _active;
+    }
+
+    void update(int64 t, uint16 prescale)
+    {
+        if (count(t) >= TIMER_COUNT_SHOW - UPDATE_GUARD_TICKS)
+            _deferred = prescale;
+        else
+            _pending = prescale;
+    }
+
+    uint16 prescale()
+    {
+        return _active;
+    }
+
+private:
+    int64                   _update;    // cycle of the last update event
+    uint16                  _active;
+    uint16                  _pending;
+    uint16                  _deferred;
+};
+
+int main(int argc, char **argv)
+{
+    bool open_loop = false;
+    bool trace = false;
+    uint32 revs = DEFAULT_REVS;
+    double hz = DEFAULT_HZ;
+    double drift_hz = DEFAULT_DRIFT_HZ;
+    double drift_s = DEFAULT_DRIFT_S;
+    double jitter_us = DEFAULT_JITTER_US;
+    double glitches = DEFAULT_GLITCHES;
+    double misses = DEFAULT_MISSES;
+    unsigned int seed = DEFAULT_SEED;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "otn:f:d:p:j:g:m:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o': open_loop = true; break;
+            case 't': trace = true; break;
+            case 'n': revs = strtoul(optarg, NULL, 0); break;
+            case 'f': hz = atof(optarg); break;
+            case 'd': drift_hz = atof(optarg); break;
+            case 'p': drift_s = atof(optarg); break;
+            case 'j': jitter_us = atof(optarg); break;
+            case 'g': glitches = atof(optarg); break;
+            case 'm': misses = atof(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-o] [-t] [-n revs] [-f hz] [-d drift hz] [-p drift s]\n"
+                                "       [-j jitter us] [-g glitches] [-m misses] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    noise.seed(seed);
+
+    StrobeTimer timer(DEFAULT_PRESCALE);
+    TachCapture tach;
+    SpeedLock lock;
+    lock.reset(DEFAULT_PRESCALE);
+
+    double rotor = 0.1;                 // seconds, time of the next index
+    double locked_at = -1;
+    uint32 updates = 0;
+    uint32 locked_revs = 0;
+    int32 worst = 0;
+    double sum_squares = 0;
+    double slip = 0;                    // phase ticks, unwrapped
+    int32 last_phase = -1;
+
+    if (trace)
+        printf("# rev seconds phase error prescale rotor locked\n");
+
+    for (uint32 rev = 0; rev < revs; ++rev)
+    {
+        double now = rotor;
+        double speed = hz + drift_hz * sin(2 * M_PI * now / drift_s);
+        rotor += 1.0 / speed;
+
+        // a spurious edge somewhere in the revolution up to this index
+        if (uniform() < glitches)
+        {
+            int64 t = (now - uniform() / speed) * CLOCK_FREQUENCY;
+            tach.capture(timer.count(t), (uint32)t);
+        }
+        if (uniform() < misses)
+            continue;
+
+        int64 t = (now + gaussian() * jitter_us * 1e-6) * CLOCK_FREQUENCY;
+        uint16 count = timer.count(t);
+        tach.capture(count, (uint32)t);
+
+        // where the index really is, for the figures below
+        int32 phase = count & (PHASE_COUNT - 1);
+        int32 error = ((phase - TACH_PHASE + PHASE_COUNT / 2) & (PHASE_COUNT - 1)) - PHASE_COUNT / 2;
+        if (last_phase >= 0)
+            slip += ((phase - last_phase + PHASE_COUNT / 2) & (PHASE_COUNT - 1)) - PHASE_COUNT / 2;
+        last_phase = phase;
+
+        // the main loop, a frame later
+        tach_window_t window;
+        if (!open_loop && tach.take(&window))
+        {
+            uint16 prescale = lock.update(window);
+            tach.expect(lock.rotor_cycles());
+            timer.update(t + CLOCK_FREQUENCY / BASE_FREQUENCY, prescale);
+            updates++;
+            if (lock.locked() && locked_at < 0)
+                locked_at = now;
+        }
+
+        if (locked_at >= 0)
+        {
+            locked_revs++;
+            worst = max(worst, abs(error));
+            sum_squares += (double)error * error;
+        }
+        if (trace)
+            printf("%u %.3f %d %d %u %.3f %d\n", rev, now, phase, error, timer.prescale(),
+                   lock.rotor_q16() / 65536.0, lock.locked());
+    }
+
+    double seconds = rotor;
+    if (trace)
+        return 0;
+    printf("%u revolutions in %.1f s, rotor %.2f Hz +- %.2f Hz every %.0f s\n",
+           revs, seconds, hz, drift_hz, drift_s);
+    printf("index jitter %.0f us, %.1f%% spurious, %.1f%% missed, %u edges rejected\n",
+           jitter_us, glitches * 100, misses * 100, tach.rejected());
+    if (open_loop)
+    {
+        printf("open loop at prescale %u: slipped %.1f revolutions, %.1f degrees/s\n",
+               DEFAULT_PRESCALE, slip / PHASE_COUNT, slip * 360 / PHASE_COUNT / seconds);
+        return 0;
+    }
+    if (locked_at < 0)
+    {
+        printf("FAILED to lock in %u updates\n", updates);
+        return 1;
+    }
+    double rms = sqrt(sum_squares / locked_revs);
+    printf("locked after %.1f s, %u updates\n", locked_at, updates);
+    printf("after lock: error rms %.1f ticks (%.1f degrees), worst %d ticks (%.1f degrees)\n",
+           rms, rms * 360 / PHASE_COUNT, worst, worst * 360.0 / PHASE_COUNT);
+    // locked means the pattern holds still on the rotor, it must never
+    // wander off by more than an eighth of a turn
+    bool ok = worst < PHASE_COUNT / 8;
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
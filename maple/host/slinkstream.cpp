@@ -0,0 +1,447 @@
+// slinkstream: stream the show to the board live, see Stream.h.
+//
+// Runs the animation engine on the host and sends its frames over the
+// board's SerialUSB port in streaming mode, never sending more than the
+// board has granted credit for.  Reports the frame rate the link kept up
+// and how long the sender sat waiting for credit.
+//
+// With -l there is no board: a stand-in runs the same StreamReceiver and
+// FrameQueue the firmware does, on the other end of a pseudo terminal,
+// with a thread popping a frame off every column at -r frames per second
+// the way the timer ISRs would (0, the default, pops as fast as it can
+// to measure the link).  At the end it checks every frame arrived intact
+// and that the receiver never had to wait in back(), and reports how
+// often the columns ran dry while the stream was playing.
+//
+// usage: slinkstream [-n frames] [-s seed] device
+//        slinkstream -l [-r fps] [-n frames] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <termios.h>
+#include <unistd.h>
+#include "wirish.h"
+#include "Animation.h"
+#include "Stream.h"
+
+#define DEFAULT_SEED        1
+#define DEFAULT_FRAMES      11520       // one show
+#define CREDIT_TIMEOUT_MS   30000       // the board ramps the motor up first
+#define MESSAGE_SIZE        (1 + CHANNEL_COUNT)
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool write_all(int fd, const uint8 *data, size_t size)
+{
+    while (size)
+    {
+        ssize_t n = write(fd, data, size);
+        if (n < 0)
+        {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void make_raw(int fd)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+}
+
+// FNV-1a over one column of every frame, in order
+#define CHECKSUM_START      2166136261u
+
+static uint32 checksum(uint32 sum, int8 value)
+{
+    return (sum ^ (uint8)value) * 16777619;
+}
+
+/*******************************************************************************
+ ** Sender
+ ******************************************************************************/
+
+// Picks the credit status frames out of whatever the board sends.
+class CreditReader
+{
+public:
+    CreditReader()
+        : _have(0)
+    {}
+
+    // Returns the credit in the bytes read so far.
+    uint32 read(int fd)
+    {
+        uint8 buf[256];
+        uint32 credit = 0;
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        for (ssize_t idx = 0; idx < n; ++idx)
+        {
+            uint8 byte = buf[idx];
+            if (_have == 0 && byte != STATUS_FRAME_SYNC)
+                continue;
+            if (_have == 1 && byte != STATUS_FRAME_STREAM_CREDIT)
+            {
+                _have = (byte == STATUS_FRAME_SYNC) ? 1 : 0;
+                continue;
+            }
+            _frame[_have++] = byte;
+            if (_have == 5)
+            {
+                _have = 0;
+                if ((_frame[1] ^ _frame[2] ^ _frame[3]) == _frame[4])
+                    credit += _frame[2] | (_frame[3] << 8);
+            }
+        }
+        return credit;
+    }
+
+private:
+    uint8                   _frame[5];
+    uint8                   _have;
+};
+
+typedef struct send_stats
+{
+    uint32                  frames;
+    uint32                  grants;
+    uint32                  checksum[CHANNEL_COUNT];
+    double                  seconds;
+    double                  waiting;
+} send_stats_t;
+
+static bool stream_show(int fd, uint32 frames, unsigned int seed, send_stats_t *stats)
+{
+    static uint8 buf[BUFFER_SIZE * MESSAGE_SIZE + 1];
+    CreditReader reader;
+    uint32 credit = 0;
+    bool align = true;
+
+    memset(stats, 0, sizeof(*stats));
+    for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+        stats->checksum[ch] = CHECKSUM_START;
+    animation_seed(seed);
+    animation_reset();
+
+    uint8 start = 'l';
+    write_all(fd, &start, 1);
+
+    double begin = 0;
+    while (stats->frames < frames)
+    {
+        if (credit == 0)
+        {
+            double wait_start = now();
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, CREDIT_TIMEOUT_MS) <= 0)
+            {
+                fprintf(stderr, "no credit from the board\n");
+                return false;
+            }
+            uint32 granted = reader.read(fd);
+            if (granted)
+            {
+                stats->grants++;
+                credit += granted;
+            }
+            if (begin == 0)
+                begin = now();
+            else
+                stats->waiting += now() - wait_start;
+            continue;
+        }
+
+        // send as many frames as we have credit for in one go, credit
+        // never runs to more than the queue holds so they always fit
+        uint32 size = 0;
+        for (; credit && stats->frames < frames; --credit, ++stats->frames)
+        {
+            while (!animation_frame())
+            {
+                if (!animation_advance())
+                    animation_reset();
+#if BLEND_FRAMES == 0
+                align = true;
+#endif
+            }
+            if (align)
+                buf[size++] = STREAM_ALIGN;
+            align = false;
+            buf[size++] = STREAM_FRAME;
+            for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+            {
+                // as pack_phase()
+                int8 value = (int8)((phase[ch] - previous_phase[ch]) & 0xFF);
+                buf[size++] = value;
+                stats->checksum[ch] = checksum(stats->checksum[ch], value);
+            }
+        }
+        write_all(fd, buf, size);
+
+        // pick up credit as it comes without waiting for it
+        uint32 granted = reader.read(fd);
+        if (granted)
+        {
+            stats->grants++;
+            credit += granted;
+        }
+    }
+
+    uint8 end = STREAM_END;
+    write_all(fd, &end, 1);
+    stats->seconds = now() - begin;
+    return true;
+}
+
+/*******************************************************************************
+ ** Loopback stand-in for the board
+ ******************************************************************************/
+
+// SerialUSB for the StreamReceiver, on a file descriptor.
+class FdPort
+{
+public:
+    FdPort(int fd)
+        : _fd(fd), _pos(0), _len(0)
+    {}
+
+    uint32 available()
+    {
+        if (_pos == _len)
+        {
+            ssize_t n = ::read(_fd, _buf, sizeof(_buf));
+            _pos = 0;
+            _len = (n > 0) ? n : 0;
+        }
+        return _len - _pos;
+    }
+
+    uint8 read()
+    {
+        return _buf[_pos++];
+    }
+
+    void write(uint8 byte)
+    {
+        write_all(_fd, &byte, 1);
+    }
+
+    void wait(int ms)
+    {
+        struct pollfd pfd = {_fd, POLLIN, 0};
+        poll(&pfd, 1, ms);
+    }
+
+private:
+    int                     _fd;
+    uint32                  _pos;
+    uint32                  _len;
+    uint8                   _buf[4096];
+};
+
+typedef struct loopback
+{
+    int                     fd;
+    uint32                  fps;
+    FrameQueue<int8>        queue;
+    volatile bool           started;
+    volatile bool           ended;
+    uint32                  popped[CHANNEL_COUNT];
+    uint32                  checksum[CHANNEL_COUNT];
+    stream_stats_t          stream;
+} loopback_t;
+
+// The board's main loop: wait for 'l' then run the stream.
+static void *loopback_device(void *arg)
+{
+    loopback_t *lb = (loopback_t *)arg;
+    FdPort port(lb->fd);
+    StreamReceiver<FdPort> receiver(port, lb->queue);
+
+    while (!port.available() || port.read() != 'l')
+        port.wait(100);
+
+    receiver.start();
+    while (receiver.poll())
+    {
+        if (!lb->started && !lb->queue.is_empty(0))
+            lb->started = true;
+        port.wait(1);
+    }
+    lb->stream = receiver.stats();
+    lb->ended = true;
+    return NULL;
+}
+
+// The timer ISRs: every column pops a frame each period.  The columns
+// go their own way like the real ones, so a column can run dry while
+// the frame is still being received and the others have already had it.
+static void *loopback_timers(void *arg)
+{
+    loopback_t *lb = (loopback_t *)arg;
+    double period = lb->fps ? 1.0 / lb->fps : 0;
+    uint8 flags;
+
+    while (!lb->started)
+        sched_yield();
+    lb->queue.reset_stats();
+
+    double next = now();
+    while (!(lb->ended && lb->queue.is_empty(CHANNEL_COUNT - 1)))
+    {
+        bool popped = false;
+        for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+        {
+            int8 *value = lb->queue.pop_front(ch, &flags);
+            if (value)
+            {
+                lb->checksum[ch] = checksum(lb->checksum[ch], *value);
+                lb->popped[ch]++;
+                popped = true;
+            }
+        }
+
+        if (period)
+        {
+            next += period;
+            double wait = next - now();
+            if (wait > 0)
+                usleep(wait * 1e6);
+        } else if (!popped)
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static int open_loopback(loopback_t *lb, pthread_t *device, pthread_t *timers)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master))
+    {
+        perror("pty");
+        return -1;
+    }
+    int fd = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(ptsname(master));
+        return -1;
+    }
+    make_raw(fd);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+
+    lb->fd = master;
+    for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+        lb->checksum[ch] = CHECKSUM_START;
+    pthread_create(device, NULL, loopback_device, lb);
+    pthread_create(timers, NULL, loopback_timers, lb);
+    return fd;
+}
+
+/*******************************************************************************
+ ** Main
+ ******************************************************************************/
+
+int main(int argc, char **argv)
+{
+    uint32 frames = DEFAULT_FRAMES;
+    unsigned int seed = DEFAULT_SEED;
+    bool loop = false;
+    static loopback_t lb;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ln:r:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'l':
+                loop = true;
+                break;
+            case 'n':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                lb.fps = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if (optind != argc - (loop ? 0 : 1))
+    {
+        fprintf(stderr, "usage: %s [-n frames] [-s seed] device\n"
+                        "       %s -l [-r fps] [-n frames] [-s seed]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    int fd;
+    pthread_t device, timers;
+    if (loop)
+    {
+        fd = open_loopback(&lb, &device, &timers);
+    } else
+    {
+        fd = open(argv[optind], O_RDWR | O_NOCTTY);
+        if (fd < 0)
+            perror(argv[optind]);
+        else
+            make_raw(fd);
+    }
+    if (fd < 0)
+        return 1;
+    // credit is picked up between writes without waiting for it
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    send_stats_t sent;
+    if (!stream_show(fd, frames, seed, &sent))
+        return 1;
+    printf("sent %u frames in %.3f s, %.0f frames/s\n",
+           sent.frames, sent.seconds, sent.frames / sent.seconds);
+    printf("%u credit grants, %.3f s waiting for credit\n", sent.grants, sent.waiting);
+
+    if (!loop)
+        return 0;
+
+    pthread_join(device, NULL);
+    pthread_join(timers, NULL);
+    uint32 underruns = lb.queue.stats(0).underruns;
+    uint32 stall = 0;
+    bool played = true;
+    for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+    {
+        stall = max(stall, lb.queue.stats(ch).max_stall_us);
+        played = played && lb.popped[ch] == sent.frames && lb.checksum[ch] == sent.checksum[ch];
+    }
+    bool ok = lb.stream.frames == sent.frames && played &&
+              !lb.stream.dropped && !lb.stream.errors && !stall;
+    printf("loopback: %u frames received, %u dropped, %u errors, played %s\n",
+           lb.stream.frames, lb.stream.dropped, lb.stream.errors, played ? "intact" : "WRONG");
+    printf("loopback: %u underruns, %u us longest wait in back()\n", underruns, stall);
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// slinktrace: dump the frames the animation engine produces.
+//
+// Writes the per-channel phase deltas, one frame per line, for every
+// mode run on its own from a reset with its built in parameters, and
+// for the full animation_info[] show.  The random numbers are seeded,
+// so the output is fully repeatable.  The reference traces live in
+// traces/; 'make check-traces' fails on any change in the
+// choreography, 'make traces' regenerates them.
+//
+// Runs of identical frames are written once, followed by "x <count>".
+//
+// usage: slinktrace [-s seed] [-f frames] outdir
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "wirish.h"
+#include "Animation.h"
+
+#define DEFAULT_SEED    1
+#define DEFAULT_FRAMES  3072
+
+class TraceWriter
+{
+public:
+    TraceWriter(FILE *fp)
+        : _fp(fp), _repeat(0)
+    {}
+
+    ~TraceWriter()
+    {
+        flush();
+    }
+
+    void frame()
+    {
+        char line[CHANNEL_COUNT * 8];
+        int len = 0;
+        for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
+            len += sprintf(line + len, "%s%d", ch ? " " : "", phase[ch] - previous_phase[ch]);
+
+        if (_repeat && !strcmp(line, _line))
+        {
+            _repeat++;
+            return;
+        }
+        flush();
+        strcpy(_line, line);
+        _repeat = 1;
+    }
+
+    void text(const char *text)
+    {
+        flush();
+        fprintf(_fp, "%s\n", text);
+    }
+
+private:
+    void flush()
+    {
+        if (!_repeat)
+            return;
+        if (_repeat > 1)
+            fprintf(_fp, "%s x %u\n", _line, _repeat);
+        else
+            fprintf(_fp, "%s\n", _line);
+        _repeat = 0;
+    }
+
+    FILE                    *_fp;
+    uint32                  _repeat;
+    char                    _line[CHANNEL_COUNT * 8];
+};
+
+static FILE *open_trace(const char *dir, const char *name)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+        perror(path);
+    return fp;
+}
+
+static bool trace_mode(const char *dir, int32 mode, int32 frames, unsigned int seed)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "mode%d.txt", mode);
+    FILE *fp = open_trace(dir, name);
+    if (!fp)
+        return false;
+
+    animation_seed(seed);
+    animation_reset();
+    animation_start(animation_defaults(mode), frames);
+    {
+        TraceWriter trace(fp);
+        while (animation_frame())
+            trace.frame();
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool trace_show(const char *dir, unsigned int seed)
+{
+    FILE *fp = open_trace(dir, "show.txt");
+    if (!fp)
+        return false;
+
+    animation_seed(seed);
+    animation_reset();
+    {
+        TraceWriter trace(fp);
+        char text[32];
+        do
+        {
+            snprintf(text, sizeof(text), "Mode: %d", current_mode);
+            trace.text(text);
+            while (animation_frame())
+                trace.frame();
+        } while (animation_advance());
+    }
+    fclose(fp);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int seed = DEFAULT_SEED;
+    int32 frames = DEFAULT_FRAMES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:f:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frames = strtol(optarg, NULL, 0);
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "usage: %s [-s seed] [-f frames] outdir\n", argv[0]);
+        return 1;
+    }
+
+    const char *dir = argv[optind];
+    for (int32 mode = 0; mode < MODE_COUNT; ++mode)
+    {
+        if (!trace_mode(dir, mode, frames, seed))
+            return 1;
+    }
+    return trace_show(dir, seed) ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#ifndef __HOST_WIRISH_H__
+#define __HOST_WIRISH_H__
+
+// A thin stand-in for libmaple's wirish.h, just enough to compile the
+// slink animation code on the host.  Build with -DSLINK_HOST.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+
+typedef uint8_t         uint8;
+typedef uint16_t        uint16;
+typedef uint32_t        uint32;
+typedef uint64_t        uint64;
+typedef int8_t          int8;
+typedef int16_t         int16;
+typedef int32_t         int32;
+typedef int64_t         int64;
+typedef bool            boolean;
+typedef void (*voidFuncPtr)(void);
+
+#define HIGH            0x1
+#define LOW             0x0
+
+#define min(a,b)        ((a)<(b)?(a):(b))
+#define max(a,b)        ((a)>(b)?(a):(b))
+
+// Maple pin numbers
+enum
+{
+    D0, D1, D2, D3, D4, D5, D6, D7, D8, D9,
+    D10, D11, D12, D13, D14, D15, D16, D17, D18, D19,
+    D20, D21, D22, D23, D24, D25, D26, D27, D28, D29,
+    D30, D31, D32, D33, D34, D35, D36, D37, D38
+};
+
+// time
+inline uint32 micros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+inline uint32 millis()
+{
+    return micros() / 1000;
+}
+
+// WMath
+inline void randomSeed(unsigned int seed)
+{
+    if (seed != 0)
+        srandom(seed);
+}
+
+inline long random(long howbig)
+{
+    if (howbig == 0)
+        return 0;
+    return ::random() % howbig;
+}
+
+#endif // __HOST_WIRISH_H__
@@ -0,0 +1,277 @@
+#include "wirish.h"
+#include "Animation.h"
+#include "Modes.h"
+
+// the built in show, used until a sequence is loaded
+// mode, duration, parameters (see initMode())
+static const animation_info_t default_animation_info[] =
+{
+    {0, 4, {40, 0, -1, 50, 20}},
+    {1, 2, {0, 3, 1, 0, 20}},
+    {2, 3, {1, 13}},
+    // fast was 216 (=-40)
+    {3, 4, {1, 41, 165, 40, 45, 165}},
+    // deltaDistance was 20 originally
+    {4, 12, {200, 20, 10, 2, 250}},
+    // note, the velocity (8) * the stepsPerStrip (32) must = the phases steps per period (256)
+    {5, 5, {100, 0, 8, 32, 0}},
+    {6, 5, {0, 0, 8, 32, 1}},
+    {7, 2, {7}},
+    {7, 2, {7}},
+    {7, 2, {7}},
+    {7, 2, {7}},
+    {7, 2, {7}},
+};
+
+// animations
+const animation_info_t *animation_info = default_animation_info;
+uint16 animation_count = sizeof(default_animation_info) / sizeof(animation_info_t);
+
+// the random numbers of the show start over from show_seed with every
+// run, or just carry on if it is 0
+static uint32 show_seed = 0;
+static Random show_random;
+
+// overall counter
+int32 timeSoFar = 0; 
+
+// just arbitrarily large anyway, so use time units * PHASE_COUNT
+int32 timeUntilChange;
+
+int32 current_animation;
+int32 current_mode;
+static const int16 *current_param;
+
+// mode state, modes sharing an implementation share its state.  There
+// are two sets so the outgoing mode can keep running while we blend
+// into the next one.
+typedef struct mode_set
+{
+    FadeBetween fade;
+    StrobeStepping strobe;
+    SwitchBetween switcher;
+    FreezeAndFan fan;
+    BumpAndGrind bump;
+    FreakOutAndComeTogether freakout;
+} mode_set_t;
+
+static mode_set_t mode_sets[2];
+static uint8 current_set;
+
+#if BLEND_FRAMES > 0
+// the outgoing mode while blending
+static int32 blend_mode;
+static int32 blend_time;
+static int32 blend_left;
+#endif
+
+static void initMode(int32 mode, const int16 *param, mode_set_t *set);
+static void calcFrame(int32 mode, int32 tsf, mode_set_t *set, int32 *frame);
+
+// initialize phases:
+int32 phase[CHANNEL_COUNT];
+int32 previous_phase[CHANNEL_COUNT];
+
+/*******************************************************************************
+ ** Sequencing
+ ******************************************************************************/
+
+void animation_reset()
+{
+    for(int32 ch = 0; ch < CHANNEL_COUNT; ++ch)
+    {
+        phase[ch] = 0;
+        previous_phase[ch] = 0;
+    }  
+    if (show_seed != 0)
+        show_random.seed(show_seed);
+
+    /* initialize runtime variables */
+#if BLEND_FRAMES > 0
+    blend_left = 0;
+#endif
+    current_animation = 0;
+    animation_start(&animation_info[current_animation],
+                    animation_info[current_animation].duration * 256);
+}
+
+// Run the show in steps from now on, or the built in one if steps is
+// NULL.  Takes effect at the next animation_reset(), and steps has to
+// stay put until then.  A seed of 0 leaves the random numbers to
+// animation_seed(), as for the built in show.
+void animation_load(const animation_info_t *steps, uint16 count, uint32 seed)
+{
+    if (steps == NULL || count == 0)
+    {
+        steps = default_animation_info;
+        count = sizeof(default_animation_info) / sizeof(animation_info_t);
+        seed = 0;
+    }
+    animation_info = steps;
+    animation_count = count;
+    show_seed = seed;
+}
+
+// Seed the random numbers now, for shows without a seed of their own.
+void animation_seed(uint32 seed)
+{
+    show_random.seed(seed);
+}
+
+// The built in parameters for mode, or NULL if no step uses it.
+const animation_info_t *animation_defaults(int32 mode)
+{
+    for(uint16 idx = 0; idx < sizeof(default_animation_info) / sizeof(animation_info_t); ++idx)
+    {
+        if (default_animation_info[idx].mode_number == mode)
+            return &default_animation_info[idx];
+    }
+    return NULL;
+}
+
+// Start running the mode of step, with its parameters, for the given
+// number of frames.
+void animation_start(const animation_info_t *step, int32 frames)
+{
+    current_mode = step->mode_number;
+    current_param = step->param;
+    timeUntilChange = frames;
+    timeSoFar = 0;
+}
+
+// Calculate the next frame of the current animation step.  The new
+// phases land in phase[] and the old ones are kept in previous_phase[],
+// so the delta for a channel is phase[ch] - previous_phase[ch].
+// Returns false once the current step has run its course.
+bool animation_frame()
+{
+    if (timeUntilChange <= 0)
+        return false;
+
+    mode_set_t *next = &mode_sets[current_set];
+
+    // the mode picks up its parameters on the first frame of the step
+    if (timeSoFar == 0)
+        initMode(current_mode, current_param, next);
+
+    for(int ch = 0; ch < CHANNEL_COUNT; ++ch) 
+        previous_phase[ch] = phase[ch];
+
+#if BLEND_FRAMES > 0
+    if (blend_left > 0)
+    {
+        // run both modes on their own to see how far each would move
+        // the channels this frame, and move them by a mix of the two
+        // that slides from all old to all new over BLEND_FRAMES
+        int32 outgoing[CHANNEL_COUNT] = {0};
+        int32 incoming[CHANNEL_COUNT] = {0};
+        calcFrame(blend_mode, blend_time++, &mode_sets[current_set ^ 1], outgoing);
+        calcFrame(current_mode, timeSoFar, next, incoming);
+
+        blend_left--;
+        int32 weight = BLEND_FRAMES - blend_left;
+        for(int ch = 0; ch < CHANNEL_COUNT; ++ch) 
+        {
+            // a step of 200 is really a step of -56, blend the short way
+            int32 from = ((outgoing[ch] + 128) & 0xFF) - 128;
+            int32 to = ((incoming[ch] + 128) & 0xFF) - 128;
+            phase[ch] += (from * blend_left + to * weight) / BLEND_FRAMES;
+        }
+    } else
+#endif
+    {
+        calcFrame(current_mode, timeSoFar, next, phase);
+    }
+    timeSoFar++;
+    timeUntilChange--;
+    return true;
+}
+
+// Move on to the next animation step.
+// Returns false when we have run off the end of the show.
+bool animation_advance()
+{
+    current_animation++;
+    if(current_animation >= animation_count) 
+        return false;
+
+#if BLEND_FRAMES > 0
+    // keep the outgoing mode running in the other set, and let the new
+    // one carry on from the same state, as it would without a blend
+    mode_sets[current_set ^ 1] = mode_sets[current_set];
+    current_set ^= 1;
+    blend_mode = current_mode;
+    blend_time = timeSoFar;
+    blend_left = BLEND_FRAMES;
+#endif
+
+    animation_start(&animation_info[current_animation],
+                    animation_info[current_animation].duration * 256);
+    return true;
+}
+
+/*******************************************************************************
+ ** Modes
+ ******************************************************************************/
+
+// The parameters for each mode, as they appear in a step.
+static void initMode(int32 mode, const int16 *param, mode_set_t *set)
+{
+    switch(mode)
+    {
+        case 0:
+        case 1:
+            // begin, end, delta, timeTillSlow, slowDownDelay
+            set->fade.init(param[0], param[1], param[2], param[3], param[4]);
+            break;
+        case 2:
+            // velocity, delayBetweenSteps
+            set->strobe.init(param[0], param[1]);
+            break;
+        case 3:
+            // slow, fast, timePerStep, stepDelta, minStep, initialSetupTime
+            set->switcher.init(param[0], param[1], param[2], param[3], param[4], param[5]);
+            break;
+        case 4:
+            // setupTime, deltaDistance, stepDelay, velocityInMiddle, timeInMiddle
+            set->fan.init(param[0], param[1], param[2], param[3], param[4]);
+            break;
+        case 5:
+        case 6:
+            // setupTime, stepTime, velocity, stepsPerStrip, useParity
+            set->bump.init(param[0], param[1], param[2], param[3], param[4] != 0);
+            break;
+        case 7:
+            // returnStepsPower
+            set->freakout.init(param[0], show_random);
+            break;
+    }
+}
+
+// Move every channel in frame on by one frame of mode, tsf frames in.
+static void calcFrame(int32 mode, int32 tsf, mode_set_t *set, int32 *frame)
+{
+    switch(mode)
+    {
+        case 0:
+        case 1:
+            set->fade.step_frame(tsf, frame);
+            break;
+        case 2:
+            set->strobe.step_frame(tsf, frame);
+            break;
+        case 3:
+            set->switcher.step_frame(tsf, frame);
+            break;
+        case 4:
+            set->fan.step_frame(tsf, frame);
+            break;
+        case 5:
+        case 6:
+            set->bump.step_frame(tsf, frame);
+            break;
+        case 7:
+            set->freakout.step_frame(tsf, frame);
+            break;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef __ANIMATION_H__
+#define __ANIMATION_H__
+
+#include "defines.h"
+
+// The animation engine.  This is kept free of any timer or pin code
+// so it can also be compiled on the host (see maple/host).
+
+// animations
+extern const animation_info_t *animation_info;
+extern uint16 animation_count;
+
+// runtime state
+extern int32 timeSoFar;
+extern int32 timeUntilChange;
+extern int32 current_animation;
+extern int32 current_mode;
+extern int32 phase[CHANNEL_COUNT];
+extern int32 previous_phase[CHANNEL_COUNT];
+
+void animation_reset();
+void animation_load(const animation_info_t *steps, uint16 count, uint32 seed);
+void animation_seed(uint32 seed);
+const animation_info_t *animation_defaults(int32 mode);
+void animation_start(const animation_info_t *step, int32 frames);
+bool animation_frame();
+bool animation_advance();
+
+#endif // __ANIMATION_H__
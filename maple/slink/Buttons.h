@@ -0,0 +1,140 @@
+#ifndef __BUTTONS_H__
+#define __BUTTONS_H__
+
+#include "defines.h"
+#include "RingBuffer.h"
+
+// The front panel buttons, debounced without ever waiting.
+//
+// tick() runs from the SysTick interrupt every millisecond (see
+// attach_tick()) and samples every button each BUTTON_SAMPLE_MS ticks,
+// however busy the main loop is.  Every button has an integrator that
+// counts up while the pin reads pressed and down while it does not,
+// and the button only changes state once the integrator hits either
+// end.  Contact bounce shorter than BUTTON_INTEGRATOR_MAX samples never
+// gets through.
+//
+// Changes come out as events, in order, through next(), which the main
+// loop drains: a press, a long press once it has been held for
+// BUTTON_LONG_PRESS_MS, and a release.  The queue has the interrupt as
+// its only producer and the main loop as its only consumer.  If nobody
+// takes them the oldest are kept and the newest dropped.
+
+#define BUTTON_STARTUP          0
+#define BUTTON_MAINTENANCE      1
+#define BUTTON_COUNT            2
+
+#define BUTTON_SAMPLE_MS        5
+#define BUTTON_INTEGRATOR_MAX   4       // samples in agreement, 20 ms
+#define BUTTON_LONG_PRESS_MS    1000
+#define BUTTON_EVENT_DEPTH      8
+// long enough for a button held from the start to read down
+#define BUTTON_SETTLE_MS        (BUTTON_SAMPLE_MS * (BUTTON_INTEGRATOR_MAX + 2))
+
+#define BUTTON_PRESS            0
+#define BUTTON_RELEASE          1
+#define BUTTON_LONG_PRESS       2
+
+typedef struct button_event
+{
+    uint8               button;
+    uint8               type;
+} button_event_t;
+
+// where a button is and the level it reads when pressed
+typedef struct button_pin
+{
+    uint8               pin;
+    uint8               active;
+} button_pin_t;
+
+class Buttons
+{
+public:
+    Buttons(const button_pin_t *pins)
+        : _pins(pins), _ticks(0)
+    {
+        for(int idx = 0; idx < BUTTON_COUNT; ++idx)
+        {
+            _integrator[idx] = 0;
+            _down[idx] = false;
+            _long[idx] = false;
+            _down_ms[idx] = 0;
+        }
+    }
+
+    // once a millisecond, from the SysTick interrupt
+    void tick()
+    {
+        if (++_ticks < BUTTON_SAMPLE_MS)
+            return;
+        _ticks = 0;
+        uint32 now = millis();
+        for(int idx = 0; idx < BUTTON_COUNT; ++idx)
+            sample(idx, now);
+    }
+
+    // The oldest event not taken yet, false if there is none.
+    bool next(button_event_t *event)
+    {
+        return _events.pop_front(*event);
+    }
+
+    // drop every event not taken yet
+    void flush()
+    {
+        button_event_t event;
+        while (next(&event))
+        {}
+    }
+
+    bool is_down(uint8 button) const
+    {
+        return _down[button];
+    }
+
+private:
+    void sample(uint8 button, uint32 now)
+    {
+        if (digitalRead(_pins[button].pin) == _pins[button].active)
+        {
+            if (_integrator[button] < BUTTON_INTEGRATOR_MAX)
+                _integrator[button]++;
+        } else if (_integrator[button] > 0)
+        {
+            _integrator[button]--;
+        }
+
+        if (!_down[button] && _integrator[button] == BUTTON_INTEGRATOR_MAX)
+        {
+            _down[button] = true;
+            _long[button] = false;
+            _down_ms[button] = now;
+            emit(button, BUTTON_PRESS);
+        } else if (_down[button] && _integrator[button] == 0)
+        {
+            _down[button] = false;
+            emit(button, BUTTON_RELEASE);
+        } else if (_down[button] && !_long[button] && now - _down_ms[button] >= BUTTON_LONG_PRESS_MS)
+        {
+            _long[button] = true;
+            emit(button, BUTTON_LONG_PRESS);
+        }
+    }
+
+    void emit(uint8 button, uint8 type)
+    {
+        button_event_t event = {button, type};
+        _events.try_push(event);
+    }
+
+    const button_pin_t     *_pins;
+    uint8                   _ticks;
+    uint8                   _integrator[BUTTON_COUNT];
+    volatile bool           _down[BUTTON_COUNT];
+    bool                    _long[BUTTON_COUNT];
+    uint32                  _down_ms[BUTTON_COUNT];
+    RingBuffer<button_event_t, BUTTON_EVENT_DEPTH> _events;
+};
+
+#endif // __BUTTONS_H__
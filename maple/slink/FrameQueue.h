@@ -0,0 +1,169 @@
+#ifndef __FRAME_QUEUE_T__
+#define __FRAME_QUEUE_T__
+
+#include "defines.h"
+
+// A single-producer queue of whole frames, one value per channel.
+//
+// The main loop fills in the frame at the back of the queue and commits
+// it with a single index store.  Every channel's ISR reads its own column
+// with its own cursor, so the channels drain independently.  A slot is
+// only reused once every channel has read past it.
+//
+// The capacity is BUFFER_SIZE frames, one of which is always kept free.
+//
+// Each frame also carries a byte of flags that every channel sees along
+// with its value, so things like step boundaries can travel in order
+// with the frames instead of waiting for the queue to drain.
+//
+// The queue also keeps per-channel statistics: how often the channel
+// found its column empty, the lowest fill level it saw after a pop, and
+// the longest the producer had to wait on it in back().
+
+// frame flags
+#define FRAME_ALIGN             0x01    // realign to the frame boundary first
+
+typedef struct queue_stats
+{
+    uint32              underruns;
+    uint32              max_stall_us;
+    uint16              min_fill;
+} queue_stats_t;
+
+template <class T>
+class FrameQueue
+{
+public:
+    FrameQueue()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _head = 0;
+        for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+            _tail[ch] = 0;
+        reset_stats();
+    }
+
+    void reset_stats()
+    {
+        for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+        {
+            _stats[ch].underruns = 0;
+            _stats[ch].max_stall_us = 0;
+            _stats[ch].min_fill = BUFFER_SIZE;
+        }
+    }
+
+    const queue_stats_t &stats(uint8 column)
+    {
+        return _stats[column];
+    }
+
+    bool is_full()
+    {
+        return blocking_column() >= 0;
+    }
+
+    // The first channel that has yet to make room for the next frame,
+    // or -1 if there is room.
+    int8 blocking_column()
+    {
+        uint16 next = advance(_head);
+        for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+        {
+            if (_tail[ch] == next)
+                return ch;
+        }
+        return -1;
+    }
+
+    // How many frames can be pushed before back() has to wait.
+    uint16 space()
+    {
+        uint16 head = _head;
+        uint16 used = 0;
+        for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+        {
+            uint16 tail = _tail[ch];
+            uint16 fill = (head >= tail) ? (head - tail) : (head + BUFFER_SIZE - tail);
+            if (fill > used)
+                used = fill;
+        }
+        return BUFFER_SIZE - 1 - used;
+    }
+
+    bool is_empty(uint8 column)
+    {
+        return (_tail[column] == _head);
+    }
+
+    // The frame to fill in next.  Spinwaits until the slowest channel
+    // has made room for it.
+    T* back()
+    {
+        int8 column = blocking_column();
+        if (column >= 0)
+        {
+            uint32 start = micros();
+            /* spinwait */
+            while (is_full()) {}
+            uint32 stall = micros() - start;
+            if (stall > _stats[column].max_stall_us)
+                _stats[column].max_stall_us = stall;
+        }
+        return _frames[_head];
+    }
+
+    // Publish the frame returned by back() to all channels at once.
+    void push_back(uint8 flags = 0)
+    {
+        _flags[_head] = flags;
+        memory_barrier();
+        _head = advance(_head);
+    }
+
+    // Called from the ISR of the channel reading this column.  flags
+    // is set to the flags the frame was pushed with.
+    T* pop_front(uint8 column, uint8 *flags)
+    {
+        uint16 head = _head;
+        uint16 tail = _tail[column];
+        queue_stats_t *stats = _stats + column;
+        if (tail == head)
+        {
+            stats->underruns++;
+            stats->min_fill = 0;
+            return NULL;
+        }
+        memory_barrier();
+        T* ret = &(_frames[tail][column]);
+        *flags = _flags[tail];
+        tail = advance(tail);
+        _tail[column] = tail;
+
+        uint16 fill = (head >= tail) ? (head - tail) : (head + BUFFER_SIZE - tail);
+        if (fill < stats->min_fill)
+            stats->min_fill = fill;
+        return ret;
+    }
+
+private:
+    static uint16 advance(uint16 index)
+    {
+        index += 1;
+        if (index >= BUFFER_SIZE)
+            index = 0;
+        return index;
+    }
+
+    T                       _frames[BUFFER_SIZE][CHANNEL_COUNT];
+    uint8                   _flags[BUFFER_SIZE];
+    volatile uint16         _head;
+    volatile uint16         _tail[CHANNEL_COUNT];
+    queue_stats_t           _stats[CHANNEL_COUNT];
+};
+
+#endif // __FRAME_QUEUE_T__
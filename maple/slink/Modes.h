@@ -0,0 +1,445 @@
+#ifndef __MODES_H__
+#define __MODES_H__
+
+#include "defines.h"
+#include "Random.h"
+
+// The animation modes.  Each mode keeps its own state and is driven as
+//   init(params...)            at the start of an animation step
+//   step_frame(tsf, phase)     once per frame, advances the mode state
+//                              and then moves all CHANNEL_COUNT phases
+// Anything that is the same for every channel is worked out once per
+// frame, so the channel loops are just adds.
+
+// note, delta must go evenly!!
+class FadeBetween
+{
+public:
+    // A fade with no hold time (timeTillSlow 0) carries on from
+    // wherever the previous fade left its speed.
+    void init(int32 begin, int32 end, int32 delta, int32 timeTillSlow, int32 slowDownDelay)
+    {
+        _end = end;
+        _delta = delta;
+        _time_till_slow = timeTillSlow;
+        if (timeTillSlow > 0)
+        {
+            _counter = 0;
+            _step_time = begin;
+            _velocity = slowDownDelay;
+        }
+    }
+
+    void step_frame(int32 tsf, int32 *phase)
+    {
+        if (tsf >= _time_till_slow)
+        {
+            // time to slow down
+            _counter++;
+            if (_counter >= _step_time)
+            {
+                _counter = 0;
+                if (_velocity != _end)
+                    _velocity += _delta;
+            }
+        }
+
+        // start at whereever you were
+        if (tsf <= 1)
+            return;
+        for (uint8 ch = 0; ch < CHANNEL_COUNT; ++ch)
+            phase[ch] += _velocity;
+    }
+
+private:
+    int32 _end;
+    int32 _delta;
+    int32 _time_till_slow;
+    int32 _counter;
+    int32 _step_time;
+    int32 _velocity;
+};
+
+class StrobeStepping
+{
+public:
+    void init(int32 velocity, int32 delayBetweenSteps)
+    {
+        _velocity = velocity;
+        _delay = delayBetweenSteps;
+        _stored = 0;
+        _counter = 0;
+        _step = velocity;
+    }
+
+    void step_frame(int32 tsf, int32 *phase)
+    {
+        if (tsf > 1)
+        {
+            // always store up what we would have moved (whether we move or not)
+            // note, this will wrap around at 256 but that's okay
+            // because the phase does too
+            _stored += _velocity;
+
+            // if the counter hits our delay then add the velocity we've stored up
+            if (_counter >= _delay)
+            {
+                _counter = 0;
+                // don't forget to add in the velocity used on this step!
+                _step = _stored;
+                // and clear the velocity store because we used it
+                _stored = 0;
+            } else
+            {
+                _counter++;
+                _step = 0;
+            }
+        }
+
+        // most frames are spent waiting for the next step
+        if (!_step)
+            return;
+        for (uint8 ch = 0; ch < CHANNEL_COUNT; ++ch)
+            phase[ch] += _step;
+    }
+
+private:
+    int32 _velocity;
+    int32 _delay;
+    int32 _stored;
+    int32 _counter;
+    int32 _step;
+};
+
+class SwitchBetween
+{
+public:
+    void init(int32 slow, int32 fast, int32 timePerStep, int32 stepDelta, int32 minStep, int32 initialSetupTime)
+    {
+        _slow = slow;
+        _fast = fast;
+        _step_delta = stepDelta;
+        _min_step = minStep;
+        _setup_time = initialSetupTime;
+        _counter = 0;
+        _velocity = slow;
+        _step_time = timePerStep;
+    }
+
+    void step_frame(int32 tsf, int32 *phase)
+    {
+        if (tsf <= _setup_time)
+        {
+            // hold the initial speed
+        } else if (_counter >= _step_time)
+        {
+            _counter = 0;
+            if (_velocity == _slow)
+            {
+                _velocity = _fast;
+            } else
+            {
+                _velocity = _slow;
+                // only when switching back to slow do we change time
+                if (_step_time > _min_step)
+                    _step_time -= _step_delta;
+            }
+        } else
+        {
+            _counter++;
+        }
+
+        for (uint8 ch = 0; ch < CHANNEL_COUNT; ++ch)
+            phase[ch] += _velocity;
+    }
+
+private:
+    int32 _slow;
+    int32 _fast;
+    int32 _step_delta;
+    int32 _min_step;
+    int32 _setup_time;
+    int32 _counter;
+    int32 _velocity;
+    int32 _step_time;
+};
+
+class BreakInTwoAndMove
+{
+public:
+    void init(int32 holdTime, int32 velocity)
+    {
+        _hold_time = holdTime;
+        _velocity = velocity;
+    }
+
+    void step_frame(int32 tsf, int32 *phase)
+    {
+        uint8 ch;
+        if (tsf > _hold_time)
+        {
+            for (ch = 0; ch < CHANNEL_COUNT; ++ch)
+                phase[ch] += _velocity;
+            return;
+        }
+
+        // break in two pieces down the center
+        for (ch = 0; ch < 2; ++ch)
+            phase[ch] = 0;
+        for (; ch < CHANNEL_COUNT; ++ch)
+            phase[ch] = 128;
+    }
+
+private:
+    int32 _hold_time;
+    int32 _velocity;
+};
+
+class FreezeAndFan
+{
+public:
+    void init(int32 setupTime, int32 deltaDistance, int32 stepDelay, int32 velocityInMiddle, int32 timeInMiddle)
+    {
+        _setup_time = setupTime;
+        _delta_distance = deltaDistance;
+        _step_delay = stepDelay;
+        _velocity_in_middle = velocityInMiddle;
+        _time_in_middle = timeInMiddle;
+        _fanned = 0;
+        _distance = 0;
+        _counter = 0;
+        _step = 0;
+        _spin = 0;
+        // the direction to move
+        _direction = 1;
+    }
+
+    void step_frame(int32 tsf, int32 *phase)
+    {
+        if (tsf > _setup_time)
+            advance();
+
+        // the channels from the middle out are split in three: the ones
+        // still fanning forwards, the ones already done and the ones
+        // fanning backwards
+        int32 ch = 0;
+        for (; ch <= 5 - _fanned; ++ch)
+            phase[ch] += _step + _spin;
+        for (; ch < 6 + _fanned; ++ch)
+            phase[ch] += _spin;
+        for (; ch < CHANNEL_COUNT; ++ch)
+            phase[ch] += _spin - _step;
+    }
+
+private:
+    void advance()
+    {
+        // so, every stepDelay we want to advance by one all the guys that should be moving
+        // how do we know who should be moving?
+        // well, _fanned is the guy we start at.
+        // and if it's 0 then we only use half the delta distance because
+        // we want everything evenly spaced (think about it)
+        // then we can advance _fanned to stop moving those guys
+        // also, things only happen every stepDelay number of steps,
+        // so use _counter for that
+        // _step is how much to advance by
+        if (_fanned < 6)
+        {
+            if (_counter >= _step_delay)
+            {
+                _counter = 0;
+                // it's time to go a step, in the current direction
+                _step = _direction;
+                // let's see if we made it all the way to where we go
+                if ((_distance >= _delta_distance) || (_fanned == 0 && _distance >= (_delta_distance >> 1)))
+                {
+                    _distance = 0;
+                    // we made it...stop moving this guy
+                    _fanned++;
+                } else
+                {
+                    _distance++;
+                }
+            } else
+            {
+                _counter++;
+                _step = 0;
+            }
+        } else
+        {
+            // everything has gone already, so just rotate
+            if (_direction == 1)
+            {
+                _spin = _velocity_in_middle;
+            } else
+            {
+                // we want to just stay in phase
+                _spin = 0;
+            }
+
+            _step = 0;
+            // decide when to go back to doing the work...
+            if (_counter >= _time_in_middle)
+            {
+                _counter = 0;
+                // and flip the direction
+                if (_direction == 1)
+                {
+                    _direction = 255;
+                    // it's okay to reset and start again
+                    _fanned = 0;
+                } else
+                {
+                    _direction = 0;
+                    // note, we don't reset _fanned
+                    // because we don't want to go anywhere
+                }
+            } else
+            {
+                _counter++;
+            }
+        }
+    }
+
+    int32 _setup_time;
+    int32 _delta_distance;
+    int32 _step_delay;
+    int32 _velocity_in_middle;
+    int32 _time_in_middle;
+    int32 _fanned;      // channels on each side that have finished fanning
+    int32 _distance;    // how far the moving channels have gone
+    int32 _counter;
+    int32 _step;
+    int32 _spin;
+    int32 _direction;
+};
+
+class BumpAndGrind
+{
+public:
+    void init(int32 setupTime, int32 stepTime, int32 velocity, int32 stepsPerStrip, boolean useParity)
+    {
+        _setup_time = setupTime;
+        _step_time = stepTime;
+        _velocity = velocity;
+        _steps_per_strip = stepsPerStrip;
+        _use_parity = useParity;
+        _channel = 0;
+        _step = 0;
+        _counter = 0;
+        _steps = 0;
+        _direction = 1;
+    }
+
+    void step_frame(int32 tsf, int32 *phase)
+    {
+        if (tsf <= _setup_time)
+            return;
+
+        advance();
+        if (!_step)
+            return;
+
+        if (!_use_parity)
+        {
+            if (_channel >= 0 && _channel < CHANNEL_COUNT)
+                phase[_channel] += _step;
+            return;
+        }
+
+        // this used to be screwed up from translation from c?
+        //   (channel ^ _channel) & 1) == 1
+        // what it does is move the channels up to and including _channel
+        // that have the other parity to it
+        int32 last = min(_channel, CHANNEL_COUNT - 1);
+        for (int32 ch = (_channel & 1) ^ 1; ch <= last; ch += 2)
+            phase[ch] += _step;
+    }
+
+private:
+    void advance()
+    {
+        int32 velocity = _velocity;
+        if (_step == velocity)
+        {
+            // we just did a step so
+            _steps++;
+            if (_steps >= _steps_per_strip)
+            {
+                _steps = 0;
+                // advance the channel we're doing
+                _channel += _direction;
+                if (_channel == CHANNEL_COUNT)
+                {
+                    _direction = 255;
+                    // advance twice to no duplicate the one just done
+                    _channel += (_direction << 1);
+                } else if (_channel == 255)
+                {
+                    // we're done, so never move anything anymore...
+                    velocity = 0;
+                    _direction = 0;
+                }
+            }
+        }
+        // the !=255 check is to make sure we don't move once we've gone all the way through
+        if (_counter >= _step_time && _channel != 255)
+        {
+            _counter = 0;
+            _step = velocity;
+        } else
+        {
+            _counter++;
+            _step = 0;
+        }
+    }
+
+    int32 _setup_time;
+    int32 _step_time;
+    int32 _velocity;
+    int32 _steps_per_strip;
+    boolean _use_parity;
+    int32 _channel;     // the channel we're currently moving
+    int32 _step;        // how much the channel should move this frame
+    int32 _counter;     // the counter used to see if we're at stepTime
+    int32 _steps;       // when this hits stepsPerStrip, we move channels
+    int32 _direction;
+};
+
+class FreakOutAndComeTogether
+{
+public:
+    void init(int32 returnStepsPower, Random &random)
+    {
+        _return_steps_power = returnStepsPower;
+        _random = &random;
+    }
+
+    void step_frame(int32 tsf, int32 *phase)
+    {
+        uint8 ch;
+        if (tsf == 0)
+        {
+            // check this, must be even multiple of returnSteps
+            for (ch = 0; ch < CHANNEL_COUNT; ++ch)
+            {
+                // 0 to 255
+                _start[ch] = _random->next_byte();
+                _return[ch] = 256 - _start[ch];
+                phase[ch] += _start[ch];
+            }
+        } else if (tsf < (1 << _return_steps_power))
+        {
+            for (ch = 0; ch < CHANNEL_COUNT; ++ch)
+                phase[ch] += _start[ch] + ((int32)(_return[ch] * tsf) >> _return_steps_power);
+        }
+    }
+
+private:
+    int32 _return_steps_power;
+    Random *_random;
+    int32 _start[CHANNEL_COUNT];
+    int32 _return[CHANNEL_COUNT];
+};
+
+#endif // __MODES_H__
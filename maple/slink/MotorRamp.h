@@ -0,0 +1,77 @@
+#ifndef __MOTOR_RAMP_H__
+#define __MOTOR_RAMP_H__
+
+#include "defines.h"
+
+// Motor spin up as a state machine, so the show can be produced into
+// the phase queue while the motor gets there.
+//
+// The PWM goes up by one every MOTOR_RAMP_STEP_US from
+// MOTOR_START_SPEED to MOTOR_MAX_SPEED, as the blocking ramp did, and
+// the motor counts as up to speed one step after the last.  poll()
+// takes the step that is due against micros(), so it only needs
+// calling more often than once a step; each call is a compare when
+// nothing is due.  Calls that come late slow the ramp down rather than
+// bunch the steps up.
+
+#define MOTOR_START_SPEED       100
+#define MOTOR_RAMP_STEP_US      50704
+
+#define MOTOR_OFF               0
+#define MOTOR_RAMPING           1
+#define MOTOR_AT_SPEED          2
+
+class MotorRamp
+{
+public:
+    MotorRamp()
+        : _state(MOTOR_OFF), _speed(0), _next_us(0)
+    {}
+
+    void start()
+    {
+        analogWrite(MOTOR_PWM_PIN, 0);
+        digitalWrite(MOTOR_EN_PIN, HIGH);
+        _speed = MOTOR_START_SPEED;
+        analogWrite(MOTOR_PWM_PIN, _speed);
+        _next_us = micros() + MOTOR_RAMP_STEP_US;
+        _state = MOTOR_RAMPING;
+    }
+
+    // Returns true once the motor is up to speed.
+    bool poll()
+    {
+        uint32 now = micros();
+        int32 late = now - _next_us;
+
+        if (_state != MOTOR_RAMPING || late < 0)
+            return _state == MOTOR_AT_SPEED;
+        // a step at a time however late we are, the motor has to keep up
+        _next_us = (late < MOTOR_RAMP_STEP_US) ? _next_us + MOTOR_RAMP_STEP_US : now + MOTOR_RAMP_STEP_US;
+        if (_speed < MOTOR_MAX_SPEED)
+            analogWrite(MOTOR_PWM_PIN, ++_speed);
+        else
+            _state = MOTOR_AT_SPEED;
+        return _state == MOTOR_AT_SPEED;
+    }
+
+    void stop()
+    {
+        analogWrite(MOTOR_PWM_PIN, 0);
+        digitalWrite(MOTOR_EN_PIN, LOW);
+        _speed = 0;
+        _state = MOTOR_OFF;
+    }
+
+    uint8 state() const
+    {
+        return _state;
+    }
+
+private:
+    uint8               _state;
+    uint16              _speed;
+    uint32              _next_us;
+};
+
+#endif // __MOTOR_RAMP_H__
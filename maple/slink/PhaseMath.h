@@ -0,0 +1,43 @@
+#ifndef __PHASE_MATH_H__
+#define __PHASE_MATH_H__
+
+#include "defines.h"
+
+// Division-free phase arithmetic for the TimerChannel ISR.
+//
+// The timer count (overflow) and PHASE_COUNT are both powers of two,
+// so every wraparound is a mask.  The timer count is a template
+// parameter so the masks end up as immediates; there is one
+// instantiation per timer configuration, TIMER_COUNT_SHOW and
+// TIMER_COUNT_MAINTENANCE.  maple/host/phasecheck holds them to the
+// % and / they replaced.
+template <uint32 TC>
+class PhaseMath
+{
+    // fail to compile if either count is not a power of two
+    typedef char timer_count_is_power_of_two[((TC & (TC - 1)) == 0) ? 1 : -1];
+    typedef char phase_count_is_power_of_two[((PHASE_COUNT & (PHASE_COUNT - 1)) == 0) ? 1 : -1];
+
+public:
+    // ((relative_phase - 128 + 512) % 256) + 128, for relative_phase >= -384
+    static inline int32 offset(int32 relative_phase)
+    {
+        return ((relative_phase + 128) & 0xFF) + 128;
+    }
+
+    // phase % TC, for phase >= 0
+    static inline int32 wrap(int32 phase)
+    {
+        return phase & (TC - 1);
+    }
+
+    // The next PHASE_COUNT boundary at or after phase, wrapped.  Same as
+    // (((phase / PHASE_COUNT) + 1) * PHASE_COUNT) % TC when phase is not
+    // already on a boundary.
+    static inline int32 align(int32 phase)
+    {
+        return wrap((phase + PHASE_COUNT - 1) & ~(PHASE_COUNT - 1));
+    }
+};
+
+#endif // __PHASE_MATH_H__
@@ -0,0 +1,28 @@
+#ifndef __POT_SCALE_H__
+#define __POT_SCALE_H__
+
+#include "defines.h"
+
+// The maintenance pots, read into BRIGHTNESS and PRESCALE.
+//
+// All integer, there is no FPU.  Both used to go through float, and
+// truncate back to int; these give exactly the same numbers for every
+// 12-bit ADC value, which maple/host/potcheck checks on the host.
+
+#define POT_SAMPLES             50
+#define POT_MAX                 4095
+
+// Map x from the in range to the out range, rounding toward zero.
+inline int32 scale(int32 x, int32 in_min, int32 in_max, int32 out_min, int32 out_max)
+{
+    int32 span = in_max - in_min;
+    return (out_min * span + (x - in_min) * (out_max - out_min)) / span;
+}
+
+// the mean of samples ADC reads that add up to sum, rounded down
+inline int32 pot_average(uint32 sum, int32 samples)
+{
+    return sum / samples;
+}
+
+#endif // __POT_SCALE_H__
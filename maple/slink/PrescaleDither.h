@@ -0,0 +1,76 @@
+#ifndef __PRESCALE_DITHER_H__
+#define __PRESCALE_DITHER_H__
+
+#include "defines.h"
+
+// Fractional strobe frequency.
+//
+// A revolution is PHASE_COUNT ticks of PRESCALE core cycles, so the
+// strobe runs at CLOCK_FREQUENCY / (PRESCALE * PHASE_COUNT) and one
+// prescale step is about 35 mHz near BASE_FREQUENCY.  The prescaler
+// only loads at an update event, so in between steps the prescale is
+// dithered from one timer period to the next: a first order sigma
+// delta on the Q16 fraction picks the integer below or above, and the
+// periods average out to the Q16 prescale.  The error it carries is
+// under one prescale step for one period, so it never adds up.
+//
+// Plain arithmetic again, maple/host/slinkfreq checks it on the host.
+
+// Q16 prescale for a strobe frequency in mHz, rounded, and held to
+// MIN_PRESCALE..MAX_PRESCALE before it is narrowed, so a frequency out
+// of range (0 mHz too) gets the nearest end of it
+inline uint32 prescale_q16_from_millihz(uint32 millihz)
+{
+    if (millihz == 0)
+        return (uint32)MAX_PRESCALE << 16;
+    uint64 cycles = (uint64)CLOCK_FREQUENCY * 1000 << 16;
+    uint64 ticks = (uint64)millihz * PHASE_COUNT;
+    uint64 prescale_q16 = (cycles + ticks / 2) / ticks;
+    prescale_q16 = max(prescale_q16, (uint64)MIN_PRESCALE << 16);
+    prescale_q16 = min(prescale_q16, (uint64)MAX_PRESCALE << 16);
+    return prescale_q16;
+}
+
+class PrescaleDither
+{
+public:
+    PrescaleDither()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _residue = 0;
+        _last_residue = 0;
+    }
+
+    // the prescale for the next timer period
+    uint16 next(uint32 prescale_q16)
+    {
+        _last_residue = _residue;
+        return step(prescale_q16);
+    }
+
+    // The period next() was for gets another prescale after all: take
+    // that step again, so the periods that actually ran still average
+    // out.
+    uint16 redo(uint32 prescale_q16)
+    {
+        _residue = _last_residue;
+        return step(prescale_q16);
+    }
+
+private:
+    uint16 step(uint32 prescale_q16)
+    {
+        uint32 sum = _residue + (prescale_q16 & 0xFFFF);
+        _residue = sum & 0xFFFF;
+        return (prescale_q16 >> 16) + (sum >> 16);
+    }
+
+    uint16              _residue;
+    uint16              _last_residue;
+};
+
+#endif // __PRESCALE_DITHER_H__
@@ -0,0 +1,53 @@
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include "defines.h"
+
+// A small seedable random number generator for the animation modes.
+//
+// Marsaglia's xorshift32: three shifts and three xors a draw, all plain
+// uint32 arithmetic, so a seed gives the same numbers on the board and
+// on the host (see maple/host).  Its period is 2^32 - 1 and it never
+// leaves the all zero state, so that is swapped for a fixed one.
+#define RANDOM_ZERO_SEED        0x9E3779B9
+
+class Random
+{
+public:
+    Random()
+    {
+        seed(0);
+    }
+
+    void seed(uint32 seed)
+    {
+        _state = seed ? seed : RANDOM_ZERO_SEED;
+    }
+
+    uint32 next()
+    {
+        uint32 x = _state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        _state = x;
+        return x;
+    }
+
+    // 0..255, the top bits are the best ones
+    uint8 next_byte()
+    {
+        return next() >> 24;
+    }
+
+    // 0..howbig-1 without a division: the top of next() * howbig
+    uint32 below(uint32 howbig)
+    {
+        return ((uint64)next() * howbig) >> 32;
+    }
+
+private:
+    uint32 _state;
+};
+
+#endif // __RANDOM_H__
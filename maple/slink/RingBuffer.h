@@ -3,58 +3,124 @@
 
 #include "defines.h"
 
-template <class T>
+// A lock-free single-producer, single-consumer ring buffer.
+//
+// N must be a power of two.  The head and tail are free-running
+// counters that are only ever masked when indexing, so the fill level is
+// simply head - tail and all N slots are usable.  Only the producer
+// writes _head and only the consumer writes _tail, so one side can live
+// in the main loop and the other in an ISR without disabling interrupts.
+template <class T, uint16 N>
 class RingBuffer
 {
+    // fails to compile if N is not a power of two
+    typedef char capacity_is_power_of_two[((N & (N - 1)) == 0) ? 1 : -1];
+
 public:
     RingBuffer()
     {
-        _capacity = BUFFER_SIZE;
-        _buffer_end = _buffer + _capacity;
-        _head = _buffer;
-        _tail = _head;
+        reset();
+    }
+
+    void reset()
+    {
+        _head = 0;
+        _tail = 0;
+    }
+
+    uint16 capacity() const
+    {
+        return N;
+    }
+
+    uint16 size() const
+    {
+        return (uint16)(_head - _tail);
+    }
+
+    uint16 available() const
+    {
+        return N - size();
     }
 
-    bool is_full()
+    bool is_full() const
     {
-        uint32 hd = (_head - _buffer);
-        uint32 tl = (_tail - _buffer);
-        return ((hd + 1) % _capacity) == tl;
+        return size() == N;
     }
 
-    bool is_empty()
+    bool is_empty() const
     {
-        return (_head == _tail);
+        return _head == _tail;
     }
 
-    bool push_back(const T item)
+    // Producer side
+
+    bool try_push(const T item)
+    {
+        uint16 head = _head;
+        if ((uint16)(head - _tail) == N)
+            return false;
+        _buffer[head & MASK] = item;
+        memory_barrier();
+        _head = head + 1;
+        return true;
+    }
+
+    void push_back(const T item)
     {
         /* spinwait */
-        while (is_full()) {}
-        *_head = item;
-        _head += 1;
-        if (_head >= _buffer_end)
-            _head = _buffer;
+        while (!try_push(item)) {}
+    }
+
+    // Push up to count items, returns how many made it in.
+    uint16 push_n(const T *items, uint16 count)
+    {
+        uint16 head = _head;
+        uint16 room = N - (uint16)(head - _tail);
+        if (count > room)
+            count = room;
+        for(uint16 idx = 0; idx < count; ++idx)
+            _buffer[(head + idx) & MASK] = items[idx];
+        memory_barrier();
+        _head = head + count;
+        return count;
+    }
+
+    // Consumer side
+
+    bool pop_front(T &item)
+    {
+        uint16 tail = _tail;
+        if (tail == _head)
+            return false;
+        memory_barrier();
+        item = _buffer[tail & MASK];
+        memory_barrier();
+        _tail = tail + 1;
         return true;
     }
 
-    T* pop_front()
+    // Pop up to count items, returns how many were read.
+    uint16 pop_n(T *items, uint16 count)
     {
-        if (is_empty())
-            return NULL;
-        T* ret = const_cast<T*>(_tail);
-        _tail += 1;
-        if(_tail >= _buffer_end)
-            _tail = _buffer;
-        return ret;
+        uint16 tail = _tail;
+        uint16 ready = (uint16)(_head - tail);
+        if (count > ready)
+            count = ready;
+        memory_barrier();
+        for(uint16 idx = 0; idx < count; ++idx)
+            items[idx] = _buffer[(tail + idx) & MASK];
+        memory_barrier();
+        _tail = tail + count;
+        return count;
     }
 
 private:
-    size_t                  _capacity;
-    T                       _buffer[BUFFER_SIZE];
-    T                       *_buffer_end;
-    T volatile              *_head;
-    T volatile              *_tail;
+    enum { MASK = N - 1 };
+
+    T                       _buffer[N];
+    volatile uint16         _head;
+    volatile uint16         _tail;
 };
 
 #endif // __RING_BUFFER_T__
@@ -0,0 +1,102 @@
+#include "wirish.h"
+#include "flash_stm32.h"
+#include "Sequence.h"
+#include "Animation.h"
+#include "TimerControl.h"
+
+// how long an upload may go quiet before we give up on it
+#define SEQUENCE_UPLOAD_TIMEOUT_MS  1000
+
+static const sequence_t *const StoredSequence = (const sequence_t *)SEQUENCE_ADDRESS;
+
+// Run the stored sequence if there is a good one, the built in show
+// otherwise.  The steps are used straight out of flash.
+void sequence_load()
+{
+    if (sequence_check(StoredSequence) == SEQUENCE_OK)
+        animation_load(StoredSequence->step, StoredSequence->header.count,
+                       StoredSequence->header.seed);
+    else
+        animation_load(NULL, 0, 0);
+}
+
+// Erase the sequence page and write seq to it.  The flash is stalled
+// while this runs, code included, so it must not happen during a show.
+static uint8 sequence_store(const sequence_t *seq)
+{
+    // nothing may run from the page while it is rewritten
+    animation_load(NULL, 0, 0);
+
+    uint8 result = SEQUENCE_OK;
+    const uint16 *data = (const uint16 *)seq;
+    uint32 size = sequence_size(seq->header.count);
+
+    FLASH_Unlock();
+    if (FLASH_ErasePage(SEQUENCE_ADDRESS) != FLASH_COMPLETE)
+        result = SEQUENCE_FLASH_ERROR;
+    for (uint32 offset = 0; result == SEQUENCE_OK && offset < size; offset += 2)
+    {
+        if (FLASH_ProgramHalfWord(SEQUENCE_ADDRESS + offset, *data++) != FLASH_COMPLETE)
+            result = SEQUENCE_FLASH_ERROR;
+    }
+    FLASH_Lock();
+
+    if (result == SEQUENCE_OK && sequence_check(StoredSequence) != SEQUENCE_OK)
+        result = SEQUENCE_FLASH_ERROR;
+    return result;
+}
+
+// Read size bytes from SerialUSB, false if they don't turn up in time.
+static bool sequence_read(uint8 *data, uint32 size)
+{
+    uint32 last = millis();
+    while (size)
+    {
+        if (SerialUSB.available())
+        {
+            *data++ = SerialUSB.read();
+            size--;
+            last = millis();
+        } else if (millis() - last > SEQUENCE_UPLOAD_TIMEOUT_MS)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint8 sequence_receive(bool busy)
+{
+    static sequence_t seq;
+
+    if (!sequence_read((uint8 *)&seq.header, sizeof(seq.header)))
+        return SEQUENCE_TIMEOUT;
+    if (!sequence_header_valid(&seq.header))
+        return SEQUENCE_BAD_HEADER;
+    if (!sequence_read((uint8 *)seq.step, seq.header.count * sizeof(animation_info_t)))
+        return SEQUENCE_TIMEOUT;
+
+    uint8 result = sequence_check(&seq);
+    if (result != SEQUENCE_OK)
+        return result;
+    if (busy)
+        return SEQUENCE_BUSY;
+
+    result = sequence_store(&seq);
+    sequence_load();
+    return result;
+}
+
+// Handles the 'u' command: a sequence image (see maple/host/seqc)
+// follows, and is stored if it is good and we are not busy running a
+// show.  The new show starts with the next run.  Answers with a status
+// frame: sync, type (0x02), result (SEQUENCE_*), xor of type and result.
+void sequence_upload(bool busy)
+{
+    uint8 result = sequence_receive(busy);
+
+    SerialUSB.write(STATUS_FRAME_SYNC);
+    SerialUSB.write(STATUS_FRAME_SEQUENCE);
+    SerialUSB.write(result);
+    SerialUSB.write(STATUS_FRAME_SEQUENCE ^ result);
+}
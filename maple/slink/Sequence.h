@@ -0,0 +1,101 @@
+#ifndef __SEQUENCE_H__
+#define __SEQUENCE_H__
+
+#include "defines.h"
+
+// A show sequence as it is kept in flash and sent over SerialUSB: a
+// header, then count animation_info_t steps, all little endian.  The
+// seed starts the random numbers over with every run of the show, 0
+// draws a new one at power up (see animation_load()).  The crc is the
+// CRC-32 (as zlib) of the seed followed by the steps.  Bump
+// SEQUENCE_VERSION whenever the layout of either changes.
+
+#define SEQUENCE_MAGIC          0x4B4E4C53      // "SLNK"
+#define SEQUENCE_VERSION        2
+#define SEQUENCE_MAX_STEPS      64
+
+// result byte of the STATUS_FRAME_SEQUENCE reply to an upload
+#define SEQUENCE_OK             0
+#define SEQUENCE_TIMEOUT        1
+#define SEQUENCE_BAD_HEADER     2
+#define SEQUENCE_BAD_CRC        3
+#define SEQUENCE_BAD_STEP       4
+#define SEQUENCE_BUSY           5
+#define SEQUENCE_FLASH_ERROR    6
+
+typedef struct sequence_header
+{
+    uint32 magic;
+    uint16 version;
+    uint16 count;
+    uint32 seed;
+    uint32 crc;
+} sequence_header_t;
+
+typedef struct sequence
+{
+    sequence_header_t header;
+    animation_info_t step[SEQUENCE_MAX_STEPS];
+} sequence_t;
+
+// the layout is shared with the host, and a sequence has to fit the
+// flash page; these fail to compile otherwise
+typedef char sequence_step_size_check[(sizeof(animation_info_t) == 14) ? 1 : -1];
+typedef char sequence_page_check[(sizeof(sequence_t) <= SEQUENCE_PAGE_SIZE) ? 1 : -1];
+
+// Bytes of a sequence with count steps.
+inline uint32 sequence_size(uint16 count)
+{
+    return sizeof(sequence_header_t) + count * sizeof(animation_info_t);
+}
+
+// A bit at a time, this only runs at startup and on upload.  Pass the
+// crc so far to carry on from it, as zlib's crc32().
+inline uint32 sequence_crc(const uint8 *data, uint32 length, uint32 crc = 0)
+{
+    crc = ~crc;
+    while (length--)
+    {
+        crc ^= *data++;
+        for (uint8 bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// The crc a sequence should have.
+inline uint32 sequence_crc(const sequence_t *seq)
+{
+    uint32 crc = sequence_crc((const uint8 *)&seq->header.seed, sizeof(seq->header.seed));
+    return sequence_crc((const uint8 *)seq->step, seq->header.count * sizeof(animation_info_t), crc);
+}
+
+// Whether the header can be for a sequence we understand.
+inline bool sequence_header_valid(const sequence_header_t *header)
+{
+    return header->magic == SEQUENCE_MAGIC &&
+           header->version == SEQUENCE_VERSION &&
+           header->count > 0 && header->count <= SEQUENCE_MAX_STEPS;
+}
+
+// SEQUENCE_OK if the whole sequence is good to run.
+inline uint8 sequence_check(const sequence_t *seq)
+{
+    if (!sequence_header_valid(&seq->header))
+        return SEQUENCE_BAD_HEADER;
+    if (sequence_crc(seq) != seq->header.crc)
+        return SEQUENCE_BAD_CRC;
+    for (uint16 idx = 0; idx < seq->header.count; ++idx)
+    {
+        if (seq->step[idx].mode_number >= MODE_COUNT || seq->step[idx].duration == 0)
+            return SEQUENCE_BAD_STEP;
+    }
+    return SEQUENCE_OK;
+}
+
+#ifndef SLINK_HOST
+void sequence_load();
+void sequence_upload(bool busy);
+#endif
+
+#endif // __SEQUENCE_H__
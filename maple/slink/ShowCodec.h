@@ -0,0 +1,115 @@
+#ifndef __SHOW_CODEC_H__
+#define __SHOW_CODEC_H__
+
+#include "defines.h"
+
+// Encoded show format
+//
+// A show is a byte stream of records.  Each record starts with an
+// opcode byte:
+//
+//   SHOW_OP_ROW     CHANNEL_COUNT varints, one baked delta per channel
+//   SHOW_OP_EQUAL   one varint, used for every channel
+//   SHOW_OP_REPEAT  one varint n, the previous frame repeats n more times
+//   SHOW_OP_STEP    end of an animation step
+//   SHOW_OP_END     end of the show
+//
+// Baked deltas are the byte offsets the TimerChannel ISR schedules (see
+// maple/host/showc).  They are read as int8, zig-zag mapped so that small
+// steps in either direction stay small, and written as little-endian
+// base-128 varints.  Everything but the odd jump fits in a single byte.
+
+#define SHOW_OP_ROW         0
+#define SHOW_OP_EQUAL       1
+#define SHOW_OP_REPEAT      2
+#define SHOW_OP_STEP        3
+#define SHOW_OP_END         4
+
+// values returned by ShowDecoder::next()
+#define SHOW_FRAME          0
+#define SHOW_STEP           1
+#define SHOW_END            2
+
+inline uint32 show_zigzag(int8 value)
+{
+    return ((uint32)value << 1) ^ (uint32)(value >> 7);
+}
+
+inline int8 show_unzigzag(uint32 value)
+{
+    return (int8)((value >> 1) ^ -(int32)(value & 1));
+}
+
+// Decodes one frame at a time.  It does not allocate or touch anything
+// outside itself, so it can be driven from the main loop or from an
+// interrupt, as long as only one context owns a given decoder.
+class ShowDecoder
+{
+public:
+    void init(const uint8 *data)
+    {
+        _data = data;
+        _repeat = 0;
+        for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+            _frame[ch] = 0;
+    }
+
+    // Decode the next record.  On SHOW_FRAME the new frame is in frame().
+    uint8 next()
+    {
+        if (_repeat)
+        {
+            _repeat--;
+            return SHOW_FRAME;
+        }
+
+        uint8 delta;
+        switch(*_data++)
+        {
+            case SHOW_OP_ROW:
+                for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+                    _frame[ch] = show_unzigzag(read_varint());
+                return SHOW_FRAME;
+            case SHOW_OP_EQUAL:
+                delta = show_unzigzag(read_varint());
+                for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+                    _frame[ch] = delta;
+                return SHOW_FRAME;
+            case SHOW_OP_REPEAT:
+                // this record is itself the first repeat
+                _repeat = read_varint() - 1;
+                return SHOW_FRAME;
+            case SHOW_OP_STEP:
+                return SHOW_STEP;
+        }
+        // SHOW_OP_END, or garbage: park on the end marker
+        _data--;
+        return SHOW_END;
+    }
+
+    const uint8 *frame() const
+    {
+        return _frame;
+    }
+
+private:
+    uint32 read_varint()
+    {
+        uint32 value = 0;
+        uint8 shift = 0;
+        uint8 byte;
+        do
+        {
+            byte = *_data++;
+            value |= (uint32)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    const uint8             *_data;
+    uint32                  _repeat;
+    uint8                   _frame[CHANNEL_COUNT];
+};
+
+#endif // __SHOW_CODEC_H__
@@ -0,0 +1,282 @@
+#ifndef __SPEED_LOCK_H__
+#define __SPEED_LOCK_H__
+
+#include "defines.h"
+
+// Closed loop speed lock: keeps the strobe locked to the spinning rotor
+// by steering PRESCALE from a tachometer index.
+//
+// Every index edge is captured with the TIMER2 count and the core
+// cycle count (see TachCapture).  The timer count is where the index
+// landed in the strobe's phase, the cycle count times the revolution.
+// The prescaler only loads at the update event, once every timer period
+// (TIMER_COUNT_SHOW ticks, 32 revolutions in the show), so the
+// revolutions are gathered into a window per timer period and the loop
+// closes once a window.  SpeedLock then works like a frequency aided PLL:
+//   - the rotor's speed, as a prescale, comes from the cycles per
+//     revolution (PRESCALE is core cycles per tick and a revolution
+//     should be PHASE_COUNT ticks), and its trend over the last few windows
+//   - the phase error is carried on to the update event the new
+//     prescale loads at, and the new prescale takes it out over the
+//     period after that
+// The controller keeps the prescale as Q16, only the integer part
+// reaches the timers.
+//
+// Everything here is plain arithmetic so the loop can be modelled on
+// the host, see maple/host/slinklock.
+
+#define SPEED_LOCK_MIN_REVS     8       // good revolutions for a window to count
+#define SPEED_LOCK_TREND_SHIFT  1       // smoothing of the rotor's trend
+#define SPEED_LOCK_TOLERANCE    32      // phase ticks either side of TACH_PHASE
+#define SPEED_LOCK_SETTLE       2       // windows in tolerance before we are locked
+
+// Until the rotor's speed is known, revolutions longer or shorter than
+// the prescale range allows (with some room) are glitches or missed
+// edges.  After that anything more than 1/2^TACH_TOLERANCE_SHIFT off
+// the expected revolution is, unless TACH_MAX_REJECTS in a row are, in
+// which case the rotor has really changed speed and we start over.
+#define TACH_MIN_CYCLES         (MIN_PRESCALE * PHASE_COUNT / 8 * 7)
+#define TACH_MAX_CYCLES         (MAX_PRESCALE * PHASE_COUNT / 8 * 9)
+#define TACH_TOLERANCE_SHIFT    5
+#define TACH_MAX_REJECTS        8
+
+// The good revolutions of one timer period.
+typedef struct tach_window
+{
+    uint32              cycles;         // total of the good revolutions
+    uint16              revs;
+    uint16              count;          // timer count at the last good edge
+} tach_window_t;
+
+// The interrupt side: captures index edges into the window of the
+// current timer period.  capture() runs in the tach ISR, take() and
+// expect() in the main loop with interrupts off.
+//
+// A revolution only counts when the ones either side of it look right
+// as well.  A spurious edge close to a real one makes a revolution that
+// looks right, but the short one next to it gives it away.
+class TachCapture
+{
+public:
+    TachCapture()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _have_last = false;
+        _have_pending = false;
+        _after_reject = false;
+        _ready = false;
+        _last_cycles = 0;
+        _last_count = 0;
+        _pending = 0;
+        _pending_count = 0;
+        _expected = 0;
+        _rejects = 0;
+        _rejected = 0;
+        clear(&_window);
+        clear(&_done);
+    }
+
+    void capture(uint16 count, uint32 cycles)
+    {
+        // the timers went through an update event since the last edge,
+        // which ends the window
+        if (count < _last_count)
+        {
+            _done = _window;
+            _ready = true;
+            clear(&_window);
+        }
+        _last_count = count;
+
+        uint32 period = cycles - _last_cycles;
+        _last_cycles = cycles;
+        if (!_have_last)
+        {
+            _have_last = true;
+            return;
+        }
+        if (!plausible(period))
+        {
+            _have_pending = false;
+            _after_reject = true;
+            _rejected++;
+            if (++_rejects == TACH_MAX_REJECTS)
+                _expected = 0;
+            return;
+        }
+        _rejects = 0;
+        if (_after_reject)
+        {
+            // it may start at a spurious edge
+            _after_reject = false;
+            return;
+        }
+        if (_have_pending)
+        {
+            _window.cycles += _pending;
+            _window.revs++;
+            _window.count = _pending_count;
+        }
+        _pending = period;
+        _pending_count = count;
+        _have_pending = true;
+    }
+
+    // Hands over the last finished window, if it has enough good
+    // revolutions in it.
+    bool take(tach_window_t *window)
+    {
+        if (!_ready)
+            return false;
+        _ready = false;
+        *window = _done;
+        return window->revs >= SPEED_LOCK_MIN_REVS;
+    }
+
+    // the cycles a revolution should take from now on
+    void expect(uint32 cycles)
+    {
+        _expected = cycles;
+    }
+
+    uint32 rejected() const
+    {
+        return _rejected;
+    }
+
+private:
+    static void clear(tach_window_t *window)
+    {
+        window->cycles = 0;
+        window->revs = 0;
+        window->count = 0;
+    }
+
+    bool plausible(uint32 period)
+    {
+        if (_expected == 0)
+            return period >= TACH_MIN_CYCLES && period <= TACH_MAX_CYCLES;
+        uint32 off = (period > _expected) ? period - _expected : _expected - period;
+        return off <= (_expected >> TACH_TOLERANCE_SHIFT);
+    }
+
+    bool                _have_last;
+    bool                _have_pending;
+    bool                _after_reject;
+    bool                _ready;
+    uint32              _last_cycles;
+    uint16              _last_count;
+    uint32              _pending;       // the last revolution, not yet confirmed
+    uint16              _pending_count;
+    uint32              _expected;
+    uint8               _rejects;       // in a row
+    uint32              _rejected;
+    tach_window_t       _window;
+    tach_window_t       _done;
+};
+
+// The controller, run from the main loop once a window, early in the
+// timer period after it.
+class SpeedLock
+{
+public:
+    void reset(uint16 prescale)
+    {
+        _prescale_q16 = (uint32)prescale << 16;
+        _rotor_q16 = 0;
+        _trend_q16 = 0;
+        _error = 0;
+        _settled = 0;
+    }
+
+    // Works out the prescale for the next timer period from the window
+    // of the last one.
+    uint16 update(const tach_window_t &window)
+    {
+        // rotor cycles per revolution / PHASE_COUNT, as Q16, and how
+        // much that moves in a timer period, smoothed as the difference
+        // of two windows is a noisy thing
+        int64 rotor = ((uint64)window.cycles << 16) / ((uint32)window.revs * PHASE_COUNT);
+        if (_rotor_q16)
+            _trend_q16 += (int32)(rotor - _rotor_q16 - _trend_q16) >> SPEED_LOCK_TREND_SHIFT;
+        _rotor_q16 = rotor;
+        int64 trend = _trend_q16;
+
+        // where the index landed relative to TACH_PHASE, from
+        // -PHASE_COUNT/2 to PHASE_COUNT/2-1.  Landing later means the
+        // strobe is running fast, so it wants a longer tick.
+        _error = ((int32)((window.count & (PHASE_COUNT - 1)) - TACH_PHASE + PHASE_COUNT / 2) & (PHASE_COUNT - 1)) - PHASE_COUNT / 2;
+
+        // The phase keeps slipping at the prescale the timers have now
+        // until the new one loads, a whole period on from the end of
+        // the window.  The rotor was measured half a period back, it is
+        // a period further on by the middle of that.
+        int32 ahead = TIMER_COUNT_SHOW - window.count + TIMER_COUNT_SHOW;
+        int64 active = (int64)prescale() << 16;
+        int32 error = _error + ((rotor + trend - active) * ahead) / active;
+        error = ((error + PHASE_COUNT / 2) & (PHASE_COUNT - 1)) - PHASE_COUNT / 2;
+
+        // The new prescale runs for the period after that: aim it at the
+        // rotor's speed in the middle of it, plus enough to take the
+        // error out by its end.  Phase has no memory of whole turns, so
+        // the error is taken out the short way round.
+        int64 target = rotor + 2 * trend;
+        int64 prescale_q16 = target + ((int64)error * target) / TIMER_COUNT_SHOW;
+        prescale_q16 = max(prescale_q16, (int64)MIN_PRESCALE << 16);
+        prescale_q16 = min(prescale_q16, (int64)MAX_PRESCALE << 16);
+        _prescale_q16 = prescale_q16;
+
+        if (abs(_error) > SPEED_LOCK_TOLERANCE)
+            _settled = 0;
+        else if (_settled < SPEED_LOCK_SETTLE)
+            _settled++;
+        return prescale();
+    }
+
+    // the prescale to run the timers at, rounded
+    uint16 prescale() const
+    {
+        return (_prescale_q16 + 0x8000) >> 16;
+    }
+
+    uint32 prescale_q16() const
+    {
+        return _prescale_q16;
+    }
+
+    // the rotor's speed as a prescale, Q16
+    uint32 rotor_q16() const
+    {
+        return _rotor_q16;
+    }
+
+    // core cycles a revolution takes
+    uint32 rotor_cycles() const
+    {
+        return ((uint64)_rotor_q16 * PHASE_COUNT) >> 16;
+    }
+
+    // the phase error of the last window, in timer ticks
+    int32 error() const
+    {
+        return _error;
+    }
+
+    bool locked() const
+    {
+        return _settled == SPEED_LOCK_SETTLE;
+    }
+
+private:
+    uint32              _prescale_q16;
+    uint32              _rotor_q16;
+    int32               _trend_q16;
+    int32               _error;
+    uint8               _settled;
+};
+
+#endif // __SPEED_LOCK_H__
@@ -0,0 +1,176 @@
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#include "defines.h"
+#include "FrameQueue.h"
+
+// Live streaming: the host works out the frames and sends them over
+// SerialUSB straight into the frame queue, instead of the show.
+//
+// After the 'l' command the host sends messages, each a type byte:
+//   STREAM_FRAME   followed by CHANNEL_COUNT phase deltas, as pack_phase()
+//   STREAM_ALIGN   the next frame starts a new step, see FRAME_ALIGN
+//   STREAM_END     no more frames, the stream plays out and stops
+//
+// The host may only send as many frames as it has been given credit for.
+// Credit is granted with status frames, all values little endian:
+//   sync (0xA5), type (0x03), credit (2), xor of everything after sync
+// and is only ever granted for room there already is in the queue, so
+// back() never waits on a streamed frame.  The first grant goes out as
+// soon as the stream starts, after that whenever STREAM_CREDIT_BATCH
+// more frames' worth of room has opened up.  Frames sent without credit
+// are dropped and counted.  If the host goes quiet for STREAM_TIMEOUT_MS
+// while it has credit the stream ends as if it had sent STREAM_END.
+// Without credit it is only waiting for room, however long the queue
+// takes to drain.
+
+#define STREAM_FRAME            0x01
+#define STREAM_ALIGN            0x02
+#define STREAM_END              0x03
+
+#define STREAM_CREDIT_BATCH     32
+#define STREAM_TIMEOUT_MS       2000
+
+typedef struct stream_stats
+{
+    uint32              frames;
+    uint32              dropped;
+    uint32              errors;
+} stream_stats_t;
+
+// Port is anything with SerialUSB's available(), read() and write(uint8).
+template <class Port>
+class StreamReceiver
+{
+public:
+    StreamReceiver(Port &port, FrameQueue<int8> &queue)
+        : _port(port), _queue(queue)
+    {}
+
+    // Call once the queue is ready for the stream, this sends the
+    // first credit.
+    void start()
+    {
+        _state = RECEIVE_TYPE;
+        _flags = 0;
+        _column = 0;
+        _credit = 0;
+        _stats.frames = 0;
+        _stats.dropped = 0;
+        _stats.errors = 0;
+        _last = millis();
+        grant();
+    }
+
+    const stream_stats_t &stats()
+    {
+        return _stats;
+    }
+
+    // Handle whatever the host has sent so far and hand out any new
+    // credit.  Returns false once the stream has ended.
+    bool poll()
+    {
+        while (_port.available())
+        {
+            uint8 byte = _port.read();
+            _last = millis();
+            if (!receive(byte))
+                return false;
+        }
+        if (_credit && millis() - _last > STREAM_TIMEOUT_MS)
+            return false;
+        grant();
+        return true;
+    }
+
+private:
+    enum
+    {
+        RECEIVE_TYPE,
+        RECEIVE_FRAME,
+        RECEIVE_DROP
+    };
+
+    bool receive(uint8 byte)
+    {
+        switch (_state)
+        {
+            case RECEIVE_TYPE:
+                switch (byte)
+                {
+                    case STREAM_FRAME:
+                        _column = 0;
+                        if (_credit == 0)
+                        {
+                            _stats.dropped++;
+                            _state = RECEIVE_DROP;
+                            break;
+                        }
+                        _credit--;
+                        _frame = _queue.back();
+                        _state = RECEIVE_FRAME;
+                        break;
+                    case STREAM_ALIGN:
+                        _flags = FRAME_ALIGN;
+                        break;
+                    case STREAM_END:
+                        return false;
+                    default:
+                        _stats.errors++;
+                        break;
+                }
+                break;
+            case RECEIVE_FRAME:
+                _frame[_column++] = (int8)byte;
+                if (_column == CHANNEL_COUNT)
+                {
+                    _queue.push_back(_flags);
+                    _flags = 0;
+                    _stats.frames++;
+                    _state = RECEIVE_TYPE;
+                }
+                break;
+            case RECEIVE_DROP:
+                if (++_column == CHANNEL_COUNT)
+                    _state = RECEIVE_TYPE;
+                break;
+        }
+        return true;
+    }
+
+    // Give the host credit for the room in the queue it doesn't already
+    // have credit for.  A frame being received still counts against
+    // the room until it is pushed.
+    void grant()
+    {
+        uint16 room = _queue.space() - (_state == RECEIVE_FRAME ? 1 : 0);
+        if (room < _credit + STREAM_CREDIT_BATCH)
+            return;
+
+        // the host's time to answer starts now
+        if (_credit == 0)
+            _last = millis();
+        uint16 credit = room - _credit;
+        _credit += credit;
+        uint8 lo = credit & 0xFF;
+        uint8 hi = credit >> 8;
+        _port.write(STATUS_FRAME_SYNC);
+        _port.write(STATUS_FRAME_STREAM_CREDIT);
+        _port.write(lo);
+        _port.write(hi);
+        _port.write(STATUS_FRAME_STREAM_CREDIT ^ lo ^ hi);
+    }
+
+    Port                   &_port;
+    FrameQueue<int8>       &_queue;
+    uint8                   _state;
+    uint8                   _flags;
+    uint8                   _column;
+    int8                   *_frame;
+    uint16                  _credit;        // frames the host may still send
+    uint32                  _last;
+    stream_stats_t          _stats;
+};
+
+#endif // __STREAM_H__
@@ -4,6 +4,9 @@
 // TimerChannel
 TimerChannel TimerChannels[CHANNEL_COUNT];
 
+// Phase queue shared by all TimerChannels
+FrameQueue<int8> PhaseQueue;
+
 // Brightness
 uint16 BRIGHTNESS;
 
@@ -13,31 +16,114 @@ uint16 PRESCALE;
 // Timer Count
 uint16 TIMER_COUNT;
 
+// What the timers run with right now.  The foreground owns BRIGHTNESS
+// and PRESCALE and hands them over with timer_update(), the ISRs only
+// ever look at these.  The prescale is Q16, see PrescaleDither.h.
+typedef struct timer_settings
+{
+    uint32              prescale_q16;
+    uint16              brightness;
+} timer_settings_t;
+
+#define UPDATE_LOADING      0x01    // timer_loading is in the prescalers
+#define UPDATE_STAGED       0x02    // timer_staged waits for the update interrupt
+
+static timer_settings_t timer_active;
+static timer_settings_t timer_loading;
+static timer_settings_t timer_staged;
+static volatile uint8 timer_update_state;
+
+// the dithered prescale of this timer period and of the next one
+static PrescaleDither timer_dither;
+static uint16 timer_prescale;
+static uint16 timer_prescale_next;
+
+#if defined(ISR_PROFILE) || defined(SPEED_LOCK)
+// Cortex-M3 debug registers for the cycle counter
+#define DEMCR               (*(volatile uint32 *)0xE000EDFC)
+#define DEMCR_TRCENA        (1 << 24)
+#define DWT_CTRL            (*(volatile uint32 *)0xE0001000)
+#define DWT_CTRL_CYCCNTENA  (1 << 0)
+#define DWT_CYCCNT          (*(volatile uint32 *)0xE0001004)
+#endif
+
+// Cortex-M3 system control and NVIC registers
+#define SCB_VTOR            (*(volatile uint32 *)0xE000ED08)
+#define SCB_SHPR_SYSTICK    (*(volatile uint8 *)0xE000ED23)
+#define NVIC_ISER           ((volatile uint32 *)0xE000E100)
+#define NVIC_IPR            ((volatile uint8 *)0xE000E400)
+
+// STM32F103 interrupt numbers, the vector table starts with 16
+// system exceptions.  60 IRQs covers the high density parts.
+#define VECTOR_SYSTICK      15
+#define IRQ_TIM2            28
+#define IRQ_TIM3            29
+#define IRQ_TIM4            30
+#define IRQ_USB_LP          20
+#define IRQ_EXTI9_5         23
+#define TIMER_DISPATCH_COUNT    3
+#define VECTOR_COUNT        (16 + 60)
+
+// Capture/compare interrupt flags in TIMx_SR (and enables in TIMx_DIER)
+#define TIMER_SR_CC_MASK    0x001E
+// Update interrupt flag in TIMx_SR (and enable in TIMx_DIER)
+#define TIMER_SR_UIF        0x0001
+// Auto-reload preload enable in TIMx_CR1
+#define TIMER_CR1_ARPE      0x0080
+// Update generation in TIMx_EGR
+#define TIMER_EGR_UG        0x0001
+
+// Output compare modes (OCxM) in TIMx_CCMRx
+#define OCM_ACTIVE          0x0010
+#define OCM_INACTIVE        0x0020
+#define OCM_FORCE_INACTIVE  0x0040
+
 // Channel Map
-// This associates a Pin with a timer, a channel, and a compare interrupt.
+// This associates a Pin with a timer and a channel.
 // It is used to initialize the individual TimerChannel objects.
 // Pin mappings are sourced from libmaple/timers.h and libmaple/boards.h
+// The four channels of a timer must be listed in order, one after the
+// other, since the timer's interrupt indexes them from first_channel.
 const pin_timer_channel_t ChannelMap[] = 
 {
     // TIMER2
-    {D2, TIMER2, 1, timer2_ch1_interrupt}, 
-    {D3, TIMER2, 2, timer2_ch2_interrupt}, 
-    {D1, TIMER2, 3, timer2_ch3_interrupt}, 
-    {D0, TIMER2, 4, timer2_ch4_interrupt},
+    {D2, TIMER2, 1}, 
+    {D3, TIMER2, 2}, 
+    {D1, TIMER2, 3}, 
+    {D0, TIMER2, 4},
 
     // TIMER3
-    {D12, TIMER3, 1, timer3_ch1_interrupt}, 
-    {D11, TIMER3, 2, timer3_ch2_interrupt}, 
-    {D27, TIMER3, 3, timer3_ch3_interrupt}, 
-    {D28, TIMER3, 4, timer3_ch4_interrupt},
+    {D12, TIMER3, 1}, 
+    {D11, TIMER3, 2}, 
+    {D27, TIMER3, 3}, 
+    {D28, TIMER3, 4},
 
     // TIMER4
-    {D5, TIMER4, 1, timer4_ch1_interrupt}, 
-    {D9, TIMER4, 2, timer4_ch2_interrupt}, 
-    {D14, TIMER4, 3, timer4_ch3_interrupt}, 
-    {D24, TIMER4, 4, timer4_ch4_interrupt}
+    {D5, TIMER4, 1}, 
+    {D9, TIMER4, 2}, 
+    {D14, TIMER4, 3}, 
+    {D24, TIMER4, 4}
 };
 
+// Timer Dispatch
+// Each timer has a single interrupt handler that services all of its
+// pending compares.  They are installed straight into the vector table,
+// bypassing libmaple's per-channel dispatch.  There is a handler per
+// timer configuration (see PhaseMath.h), TIMER_COUNT picks the one used.
+const timer_dispatch_t TimerDispatch[] =
+{
+    {TIMER2, IRQ_TIM2, 0, {timer2_interrupt<TIMER_COUNT_SHOW>, timer2_interrupt<TIMER_COUNT_MAINTENANCE>}},
+    {TIMER3, IRQ_TIM3, 4, {timer3_interrupt<TIMER_COUNT_SHOW>, timer3_interrupt<TIMER_COUNT_MAINTENANCE>}},
+    {TIMER4, IRQ_TIM4, 8, {timer4_interrupt<TIMER_COUNT_SHOW>, timer4_interrupt<TIMER_COUNT_MAINTENANCE>}}
+};
+
+// Vector table copy in RAM, see install_ram_vectors()
+static voidFuncPtr RamVectors[VECTOR_COUNT] __attribute__ ((aligned (512)));
+
+// libmaple's SysTick handler, and what attach_tick() runs after it
+static voidFuncPtr systick_handler;
+static voidFuncPtr tick_hook;
+
 // TimerChannel
 void TimerChannel::init(const pin_timer_channel_t *tpin)
 {
@@ -46,65 +132,53 @@ void TimerChannel::init(const pin_timer_channel_t *tpin)
     _timer = tpin->timer;
     _channel = tpin->channel;
     _pin = tpin->pin;
+    _column = tpin - ChannelMap;
     _last_phase = 0;
     _state = STATE_OFF;
 
     pinMode(_pin, PWM);
     timer_port *timer = timer_dev_table[_timer].base;
-    switch(_channel)
-    {
-        case 1:
-            timer->CCMR1 &= ~(0x00FF);
-            timer->CCMR1 |= 0x0040;
-            timer->CCER |= 0x0001;
-            break;
-        case 2:
-            timer->CCMR1 &= ~(0xFF00);
-            timer->CCMR1 |= 0x4000;
-            timer->CCER |= 0x0010;
-            break;
-        case 3:
-            timer->CCMR2 &= ~(0x00FF);
-            timer->CCMR2 |= 0x0040;
-            timer->CCER |= 0x0100;
-            break;
-        case 4:
-            timer->CCMR2 &= ~(0xFF00);
-            timer->CCMR2 |= 0x4000;
-            timer->CCER |= 0x1000;
-            break;
-    }
-    timer_attach_interrupt(_timer, _channel, tpin->isr);
+
+    // Work out where this channel's OCxM bits live once, so set_ocm()
+    // is a single masked write.  Channels 1 and 2 share CCMR1, 3 and 4
+    // share CCMR2, the odd channel in the low byte.
+    uint8 shift = ((_channel - 1) & 1) * 8;
+    _ccmr = (_channel <= 2) ? &(timer->CCMR1) : &(timer->CCMR2);
+    _ocm_keep = ~(0x00FF << shift);
+    _ocm_on = OCM_ACTIVE << shift;
+    _ocm_off = OCM_INACTIVE << shift;
+
+    // Start out forced inactive, with the output enabled
+    *_ccmr = (*_ccmr & _ocm_keep) | (OCM_FORCE_INACTIVE << shift);
+    timer->CCER |= 0x0001 << ((_channel - 1) * 4);
     timer_set_compare_value(_timer, _channel, 0);
+    // Enable the compare interrupt, its timer's handler will take it
+    timer->SR = ~(1 << _channel);
+    timer->DIER |= (1 << _channel);
 }
 
 bool TimerChannel::is_empty()
 {
-    return _rbuf.is_empty();
-}
-
-
-// This method is called by the user-code to push 
-// phase information to this channel.
-void TimerChannel::push_back(int16 relative_phase)
-{
-    _rbuf.push_back(relative_phase);
+    return PhaseQueue.is_empty(_column);
 }
 
 // This method is called by the interrupt service routine
 // to schedule the next phase offset.
+template <uint32 TC>
 inline int16 TimerChannel::pop_front()
 {
-    int16 *phase = _rbuf.pop_front();
+    uint8 flags;
+    int8 *phase = PhaseQueue.pop_front(_column, &flags);
     if(phase == NULL)
     {
         digitalWrite(LED_PIN, !digitalRead(LED_PIN));
-        if ((_last_phase % PHASE_COUNT) != 0)
-        {
-            _last_phase = (((_last_phase / PHASE_COUNT) + 1) * PHASE_COUNT) % TIMER_COUNT;
-        }
+        _last_phase = PhaseMath<TC>::align(_last_phase);
         return 0;
     } 
+    // a new animation step starts from the frame boundary, just as it
+    // would after running dry
+    if(flags & FRAME_ALIGN)
+        _last_phase = PhaseMath<TC>::align(_last_phase);
     return *phase;
 }
 
@@ -114,50 +188,7 @@ inline int16 TimerChannel::pop_front()
 // onoff to false, a compare interrupt will set the mapped pin to low.
 inline void TimerChannel::set_ocm(bool onoff)
 {
-    timer_port *timer = timer_dev_table[_timer].base;
-    if (onoff)
-    {
-        switch(_channel)
-        {
-            case 1:
-                timer->CCMR1 &= ~(0x00FF);
-                timer->CCMR1 |= 0x0010;
-                break;
-            case 2:
-                timer->CCMR1 &= ~(0xFF00);
-                timer->CCMR1 |= 0x1000;
-                break;
-            case 3:
-                timer->CCMR2 &= ~(0x00FF);
-                timer->CCMR2 |= 0x0010;
-                break;
-            case 4:
-                timer->CCMR2 &= ~(0xFF00);
-                timer->CCMR2 |= 0x1000;
-                break;
-        }
-    } else
-    {
-        switch(_channel)
-        {
-            case 1:
-                timer->CCMR1 &= ~(0x00FF);
-                timer->CCMR1 |= 0x0020;
-                break;
-            case 2:
-                timer->CCMR1 &= ~(0xFF00);
-                timer->CCMR1 |= 0x2000;
-                break;
-            case 3:
-                timer->CCMR2 &= ~(0x00FF);
-                timer->CCMR2 |= 0x0020;
-                break;
-            case 4:
-                timer->CCMR2 &= ~(0xFF00);
-                timer->CCMR2 |= 0x2000;
-                break;
-        }
-    }
+    *_ccmr = (*_ccmr & _ocm_keep) | (onoff ? _ocm_on : _ocm_off);
 }
 
 // The interrupt service routine is called at a compare event.
@@ -165,17 +196,22 @@ inline void TimerChannel::set_ocm(bool onoff)
 // event, depending on the previous state.  If we are off, we pull
 // the next relative phase from the ring buffer and configure the
 // compare to turn off the mapped pin.  If we are 
+template <uint32 TC>
 inline void TimerChannel::isr(void) 
 {
     int32 next_phase;
+#ifdef ISR_PROFILE
+    uint32 entry = DWT_CYCCNT;
+    uint8 state = _state;
+#endif
 
     switch(_state)
     {
         // we are currently off
         case STATE_OFF:
             set_ocm(true);
-            next_phase = ((pop_front() - 128 + 512) % 256) + 128;
-            next_phase = ((next_phase * PHASE_SCALE_FACTOR) + _last_phase) % TIMER_COUNT;
+            next_phase = PhaseMath<TC>::offset(pop_front<TC>());
+            next_phase = PhaseMath<TC>::wrap((next_phase * PHASE_SCALE_FACTOR) + _last_phase);
             //next_phase = ((pop_front() * PHASE_SCALE_FACTOR) + _last_phase + PHASE_COUNT) % TIMER_COUNT;
             timer_set_compare_value(_timer, _channel, next_phase);
             _state = STATE_ON;
@@ -183,25 +219,386 @@ inline void TimerChannel::isr(void)
             break;
         case STATE_ON:
             set_ocm(false);
-            next_phase = (_last_phase + BRIGHTNESS) % TIMER_COUNT;
+            next_phase = PhaseMath<TC>::wrap(_last_phase + timer_active.brightness);
             timer_set_compare_value(_timer, _channel, next_phase);
             _state = STATE_OFF;
             break;
     }
+
+#ifdef ISR_PROFILE
+    uint32 cycles = DWT_CYCCNT - entry;
+    if (state == STATE_ON)
+    {
+        _profile.last_on = entry;
+    } else if (_profile.count)
+    {
+        int32 jitter = (int32)(entry - _profile.last_on) - (int32)(timer_active.brightness * timer_prescale);
+        uint32 bin = abs(jitter) / ISR_PROFILE_BIN_CYCLES;
+        _profile.jitter[min(bin, ISR_PROFILE_BINS - 1)]++;
+    }
+    _profile.count++;
+    _profile.total_cycles += cycles;
+    _profile.min_cycles = min(_profile.min_cycles, cycles);
+    _profile.max_cycles = max(_profile.max_cycles, cycles);
+#endif
 } 
 
-void set_prescale(bool sync)
+// Queue statistics
+static void queue_stats(uint8 column, queue_stats_t *stats)
+{
+    noInterrupts();
+    *stats = PhaseQueue.stats(column);
+    interrupts();
+}
+
+void queue_stats_reset()
 {
-    if (sync)
+    noInterrupts();
+    PhaseQueue.reset_stats();
+    interrupts();
+}
+
+void queue_stats_dump()
+{
+    queue_stats_t stats;
+
+    SerialUSB.println("Queue: underruns, min fill (frames), max stall (us)");
+    for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+    {
+        queue_stats(ch, &stats);
+        SerialUSB.print(ch);
+        SerialUSB.print(": ");
+        SerialUSB.print(stats.underruns);
+        SerialUSB.print(" ");
+        SerialUSB.print(stats.min_fill);
+        SerialUSB.print(" ");
+        SerialUSB.println(stats.max_stall_us);
+    }
+}
+
+static void status_write(uint8 byte, uint8 *check)
+{
+    SerialUSB.write(byte);
+    *check ^= byte;
+}
+
+static void status_write32(uint32 value, uint8 *check)
+{
+    for(int idx = 0; idx < 4; ++idx)
+        status_write((value >> (idx * 8)) & 0xFF, check);
+}
+
+// Binary status frame, all values little endian:
+//   sync (0xA5), type (0x01), channel count,
+//   per channel: underruns (4), max stall us (4), min fill (2),
+//   xor of everything after the sync byte
+void queue_stats_write()
+{
+    queue_stats_t stats;
+    uint8 check = 0;
+
+    SerialUSB.write(STATUS_FRAME_SYNC);
+    status_write(STATUS_FRAME_QUEUE_STATS, &check);
+    status_write(CHANNEL_COUNT, &check);
+    for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
     {
-        // Busy wait until we are sure we can update all prescale values
-        // before an update event
-        while (Timer2.getCount() > (PHASE_COUNT - 100))
-        {}
+        queue_stats(ch, &stats);
+        status_write32(stats.underruns, &check);
+        status_write32(stats.max_stall_us, &check);
+        status_write(stats.min_fill & 0xFF, &check);
+        status_write(stats.min_fill >> 8, &check);
     }
-    Timer2.setPrescaleFactor(PRESCALE);
-    Timer3.setPrescaleFactor(PRESCALE);
-    Timer4.setPrescaleFactor(PRESCALE);
+    SerialUSB.write(check);
+}
+
+#ifdef ISR_PROFILE
+void TimerChannel::profile_reset()
+{
+    noInterrupts();
+    _profile.count = 0;
+    _profile.min_cycles = 0xFFFFFFFF;
+    _profile.max_cycles = 0;
+    _profile.total_cycles = 0;
+    for(int bin = 0; bin < ISR_PROFILE_BINS; ++bin)
+        _profile.jitter[bin] = 0;
+    interrupts();
+}
+
+// Take a consistent copy of the profile, the ISR keeps running.
+void TimerChannel::profile(isr_profile_t *profile)
+{
+    noInterrupts();
+    *profile = _profile;
+    interrupts();
+}
+
+void isr_profile_reset()
+{
+    for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+        TimerChannels[ch].profile_reset();
+}
+
+void isr_profile_dump()
+{
+    isr_profile_t profile;
+
+    SerialUSB.print("ISR cycles, jitter bins of ");
+    SerialUSB.print(ISR_PROFILE_BIN_CYCLES);
+    SerialUSB.println(" cycles");
+    for(int ch = 0; ch < CHANNEL_COUNT; ++ch)
+    {
+        TimerChannels[ch].profile(&profile);
+        SerialUSB.print(ch);
+        SerialUSB.print(": n=");
+        SerialUSB.print(profile.count);
+        if (profile.count)
+        {
+            SerialUSB.print(" min=");
+            SerialUSB.print(profile.min_cycles);
+            SerialUSB.print(" max=");
+            SerialUSB.print(profile.max_cycles);
+            SerialUSB.print(" mean=");
+            SerialUSB.print(profile.total_cycles / profile.count);
+        }
+        SerialUSB.print(" jitter:");
+        for(int bin = 0; bin < ISR_PROFILE_BINS; ++bin)
+        {
+            SerialUSB.print(" ");
+            SerialUSB.print(profile.jitter[bin]);
+        }
+        SerialUSB.println("");
+    }
+}
+#endif
+
+#ifdef SPEED_LOCK
+static TachCapture tach;
+static SpeedLock speed_lock;
+// the prescale from before the lock took over
+static uint16 free_prescale;
+
+// Index edge: where the strobe is in its period, and when.  TIMER2
+// has no capture input on TACH_PIN, so the count is read here, which
+// is as good as the entry latency.
+static void tach_interrupt()
+{
+    tach.capture(timer_dev_table[TIMER2].base->CNT, DWT_CYCCNT);
+}
+
+// With the motor up to speed and the timers running the show.
+void speed_lock_start()
+{
+    free_prescale = PRESCALE;
+    noInterrupts();
+    tach.reset();
+    interrupts();
+    speed_lock.reset(PRESCALE);
+
+    pinMode(TACH_PIN, INPUT_PULLUP);
+    attachInterrupt(TACH_PIN, tach_interrupt, FALLING);
+    // below the timers, the compares must never wait behind an index
+    NVIC_IPR[IRQ_EXTI9_5] = 0x10;
+}
+
+// From the main loop, often enough to catch each window early in the
+// timer period after it.
+void speed_lock_poll()
+{
+    tach_window_t window;
+
+    noInterrupts();
+    bool ready = tach.take(&window);
+    interrupts();
+    if (!ready)
+        return;
+
+    uint16 prescale = speed_lock.update(window);
+    noInterrupts();
+    tach.expect(speed_lock.rotor_cycles());
+    interrupts();
+    if (prescale != PRESCALE)
+    {
+        PRESCALE = prescale;
+        timer_update();
+    }
+}
+
+void speed_lock_stop()
+{
+    detachInterrupt(TACH_PIN);
+    PRESCALE = free_prescale;
+    timer_update();
+}
+
+void speed_lock_dump()
+{
+    SerialUSB.print("Lock: ");
+    SerialUSB.print(speed_lock.locked() ? "locked" : "searching");
+    SerialUSB.print(" prescale=");
+    SerialUSB.print(PRESCALE);
+    SerialUSB.print(" rotor=");
+    SerialUSB.print(speed_lock.rotor_q16() >> 16);
+    SerialUSB.print(".");
+    SerialUSB.print(((speed_lock.rotor_q16() & 0xFFFF) * 1000) >> 16);
+    SerialUSB.print(" error=");
+    SerialUSB.print(speed_lock.error());
+    SerialUSB.print(" rejected=");
+    SerialUSB.println(tach.rejected());
+}
+#endif
+
+// Move the vector table to RAM the first time through, so single
+// handlers can be swapped in while everything else (USB, systick, ...)
+// keeps its libmaple handler.
+static void install_ram_vectors()
+{
+    static bool installed = false;
+    if (installed)
+        return;
+
+    voidFuncPtr *vectors = (voidFuncPtr *)SCB_VTOR;
+    for(int idx = 0; idx < VECTOR_COUNT; ++idx)
+        RamVectors[idx] = vectors[idx];
+
+    noInterrupts();
+    SCB_VTOR = (uint32)RamVectors;
+    memory_barrier();
+    interrupts();
+    installed = true;
+}
+
+// Point the timer IRQs at the dispatchers for the current TIMER_COUNT.
+static void install_timer_vectors()
+{
+    static bool installed = false;
+    uint8 config = (TIMER_COUNT == TIMER_COUNT_SHOW) ? TIMER_CONFIG_SHOW : TIMER_CONFIG_MAINTENANCE;
+
+    install_ram_vectors();
+    for(int idx = 0; idx < TIMER_DISPATCH_COUNT; ++idx)
+        RamVectors[16 + TimerDispatch[idx].irq] = TimerDispatch[idx].isr[config];
+
+    if (!installed)
+    {
+        // The compares must never wait behind USB traffic
+        NVIC_IPR[IRQ_USB_LP] = 0xF0;
+        for(int idx = 0; idx < TIMER_DISPATCH_COUNT; ++idx)
+        {
+            NVIC_IPR[TimerDispatch[idx].irq] = 0x00;
+            NVIC_ISER[TimerDispatch[idx].irq >> 5] = 1 << (TimerDispatch[idx].irq & 0x1F);
+        }
+        installed = true;
+    }
+}
+
+static void tick_interrupt()
+{
+    systick_handler();
+    tick_hook();
+}
+
+// Run hook every millisecond from SysTick, after libmaple has counted
+// the millisecond, so millis() is up to date in it.  SysTick drops to
+// the lowest priority, the compares never wait behind it.
+void attach_tick(voidFuncPtr hook)
+{
+    install_ram_vectors();
+    noInterrupts();
+    if (RamVectors[VECTOR_SYSTICK] != tick_interrupt)
+        systick_handler = RamVectors[VECTOR_SYSTICK];
+    tick_hook = hook;
+    RamVectors[VECTOR_SYSTICK] = tick_interrupt;
+    interrupts();
+    SCB_SHPR_SYSTICK = 0xF0;
+}
+
+// The prescalers only ever load at an update event, so the three
+// writes land together as long as there is no update event between
+// them.
+static inline void write_prescalers(uint16 prescale)
+{
+    timer_dev_table[TIMER2].base->PSC = prescale - 1;
+    timer_dev_table[TIMER3].base->PSC = prescale - 1;
+    timer_dev_table[TIMER4].base->PSC = prescale - 1;
+}
+
+// Hand a prescale and the current BRIGHTNESS over to the timers
+// without waiting.  Far enough from the next update event the
+// prescalers are written straight away, over what the update interrupt
+// wrote for the next period, otherwise the update interrupt writes
+// them once it is past.  Either way the brightness follows at the
+// update event the prescale loads at, so a pulse never has one
+// setting's width at the other's tick.  A later call overrides one
+// that has not taken effect yet.
+static void timer_stage(uint32 prescale_q16)
+{
+    timer_port *timer2 = timer_dev_table[TIMER2].base;
+
+    noInterrupts();
+    // an update event the interrupt has not seen yet counts as close
+    if (!(timer2->SR & TIMER_SR_UIF) && timer2->CNT < TIMER_COUNT - TIMER_UPDATE_GUARD)
+    {
+        timer_loading.prescale_q16 = prescale_q16;
+        timer_loading.brightness = BRIGHTNESS;
+        timer_prescale_next = timer_dither.redo(prescale_q16);
+        write_prescalers(timer_prescale_next);
+        timer_update_state = UPDATE_LOADING;
+    } else
+    {
+        timer_staged.prescale_q16 = prescale_q16;
+        timer_staged.brightness = BRIGHTNESS;
+        timer_update_state |= UPDATE_STAGED;
+    }
+    interrupts();
+}
+
+// the current PRESCALE and BRIGHTNESS
+void timer_update()
+{
+    timer_stage((uint32)PRESCALE << 16);
+}
+
+// A prescale between two steps, the timer periods dither between them.
+// PRESCALE becomes the nearest step.
+void set_prescale_q16(uint32 prescale_q16)
+{
+    prescale_q16 = max(prescale_q16, (uint32)MIN_PRESCALE << 16);
+    prescale_q16 = min(prescale_q16, (uint32)MAX_PRESCALE << 16);
+    PRESCALE = (prescale_q16 + 0x8000) >> 16;
+    timer_stage(prescale_q16);
+}
+
+void set_frequency_millihz(uint32 millihz)
+{
+    set_prescale_q16(prescale_q16_from_millihz(millihz));
+}
+
+// the last timer_update() has taken effect
+bool timer_update_done()
+{
+    return timer_update_state == 0;
+}
+
+// TIMER2 update event, TIMER3 and TIMER4 have theirs at the same time
+static inline void timer_update_isr()
+{
+    uint8 state = timer_update_state;
+
+    timer_prescale = timer_prescale_next;
+    if (state & UPDATE_LOADING)
+        timer_active = timer_loading;
+    if (state & UPDATE_STAGED)
+    {
+        timer_loading = timer_staged;
+        state = UPDATE_LOADING;
+    } else
+    {
+        state = 0;
+    }
+    timer_update_state = state;
+
+    // the prescale for the period after this one
+    timer_prescale_next = timer_dither.next(timer_loading.prescale_q16);
+    write_prescalers(timer_prescale_next);
 }
 
 // Configure Timers
@@ -239,14 +636,46 @@ void configure_timers(bool uev_enable)
         timer3->CR1 |= (1 << 2);
     }
 
-    // Set the timer prescales
-    set_prescale();
+    // Buffer the overflow like the prescale, and load both now with
+    // an update generation so the first period already runs with them.
+    // In the show that raises the update flag too, which is stale.
+    timer2->CR1 |= TIMER_CR1_ARPE;
+    timer3->CR1 |= TIMER_CR1_ARPE;
+    timer4->CR1 |= TIMER_CR1_ARPE;
+    write_prescalers(PRESCALE);
+    timer2->EGR = TIMER_EGR_UG;
+    timer3->EGR = TIMER_EGR_UG;
+    timer4->EGR = TIMER_EGR_UG;
+    timer2->SR = ~TIMER_SR_UIF;
+    timer3->SR = ~TIMER_SR_UIF;
+    timer4->SR = ~TIMER_SR_UIF;
+    timer_active.prescale_q16 = (uint32)PRESCALE << 16;
+    timer_active.brightness = BRIGHTNESS;
+    timer_loading = timer_active;
+    timer_update_state = 0;
+    timer_dither.reset();
+    timer_prescale = PRESCALE;
+    timer_prescale_next = PRESCALE;
+    // and take every update event from here on, see timer_update()
+    timer2->DIER |= TIMER_SR_UIF;
+
+#if defined(ISR_PROFILE) || defined(SPEED_LOCK)
+    // Start the cycle counter
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+#endif
 
     // Initialize the Timer Channels
     for(int x = 0; x < CHANNEL_COUNT; ++x)
     {
         TimerChannels[x].init(ChannelMap + x);
     }
+    install_timer_vectors();
+
+#ifdef ISR_PROFILE
+    isr_profile_reset();
+#endif
 }
 
 void start_timers()
@@ -270,16 +699,35 @@ void stop_timers()
     Timer4.setCount(0);
 }
 
-// Low level interrupt wrappers
-void timer2_ch1_interrupt(void) { TimerChannels[0].isr(); }
-void timer2_ch2_interrupt(void) { TimerChannels[1].isr(); }
-void timer2_ch3_interrupt(void) { TimerChannels[2].isr(); }
-void timer2_ch4_interrupt(void) { TimerChannels[3].isr(); }
-void timer3_ch1_interrupt(void) { TimerChannels[4].isr(); }
-void timer3_ch2_interrupt(void) { TimerChannels[5].isr(); }
-void timer3_ch3_interrupt(void) { TimerChannels[6].isr(); }
-void timer3_ch4_interrupt(void) { TimerChannels[7].isr(); }
-void timer4_ch1_interrupt(void) { TimerChannels[8].isr(); }
-void timer4_ch2_interrupt(void) { TimerChannels[9].isr(); }
-void timer4_ch3_interrupt(void) { TimerChannels[10].isr(); }
-void timer4_ch4_interrupt(void) { TimerChannels[11].isr(); }
+// Service every pending compare on one timer.  The status register
+// is read once per pass, and we keep going until nothing new has fired
+// in the meantime, so compares that land close together cost a single
+// interrupt entry.
+template <uint32 TC>
+static inline void timer_dispatch(const timer_dispatch_t *td)
+{
+    timer_port *timer = timer_dev_table[td->timer].base;
+    TimerChannel *channels = TimerChannels + td->first_channel;
+    uint16 pending;
+
+    while ((pending = (timer->SR & timer->DIER & (TIMER_SR_CC_MASK | TIMER_SR_UIF))))
+    {
+        // SR bits are cleared by writing 0, writing 1 leaves them alone
+        timer->SR = ~pending;
+        if (pending & TIMER_SR_UIF)
+            timer_update_isr();
+        if (pending & (1 << 1))
+            channels[0].isr<TC>();
+        if (pending & (1 << 2))
+            channels[1].isr<TC>();
+        if (pending & (1 << 3))
+            channels[2].isr<TC>();
+        if (pending & (1 << 4))
+            channels[3].isr<TC>();
+    }
+}
+
+// Low level interrupts
+template <uint32 TC> void timer2_interrupt(void) { timer_dispatch<TC>(TimerDispatch + 0); }
+template <uint32 TC> void timer3_interrupt(void) { timer_dispatch<TC>(TimerDispatch + 1); }
+template <uint32 TC> void timer4_interrupt(void) { timer_dispatch<TC>(TimerDispatch + 2); }
@@ -2,57 +2,128 @@
 #define __TIMERCONTROL_H__
 
 #include "defines.h"
-#include "RingBuffer.h"
+#include "FrameQueue.h"
+#include "PhaseMath.h"
+#include "PrescaleDither.h"
+#ifdef SPEED_LOCK
+#include "SpeedLock.h"
+#endif
 
 #define     STATE_OFF   0
 #define     STATE_ON    1
 #define     STATE_SPIN  2
 
+// timer_update() writes the prescalers itself up to this many ticks
+// before the update event, closer than that the update interrupt does
+#define     TIMER_UPDATE_GUARD          4
+
+// index into timer_dispatch_t::isr
+#define     TIMER_CONFIG_SHOW           0
+#define     TIMER_CONFIG_MAINTENANCE    1
+#define     TIMER_CONFIG_COUNT          2
+
 typedef struct pin_timer_channel
 {
     uint8               pin;
     timer_dev_num       timer;
     uint8               channel;
-    voidFuncPtr         isr;
 } pin_timer_channel_t;
 
+typedef struct timer_dispatch
+{
+    timer_dev_num       timer;
+    uint8               irq;
+    uint8               first_channel;
+    voidFuncPtr         isr[TIMER_CONFIG_COUNT];
+} timer_dispatch_t;
+
+#ifdef ISR_PROFILE
+// ISR cost, in core cycles, as measured with the DWT cycle counter.
+// The jitter histogram is for the on pulse: both of its compares are
+// exactly BRIGHTNESS timer ticks apart, so any difference between the
+// two ISR entries and BRIGHTNESS * PRESCALE cycles is entry latency
+// that moved between them.
+#define ISR_PROFILE_BINS        16
+#define ISR_PROFILE_BIN_CYCLES  16
+
+typedef struct isr_profile
+{
+    uint32              count;
+    uint32              min_cycles;
+    uint32              max_cycles;
+    uint32              total_cycles;
+    uint32              last_on;
+    uint32              jitter[ISR_PROFILE_BINS];
+} isr_profile_t;
+#endif
+
 class TimerChannel
 {
 public:
     void init(const pin_timer_channel_t *tpin);
-    void push_back(int16 relative_phase);
-    inline int16 pop_front();
+    template <uint32 TC> inline int16 pop_front();
     bool is_empty();
     inline void set_ocm(bool onoff);
-    inline void isr(void);
+    template <uint32 TC> inline void isr(void);
+#ifdef ISR_PROFILE
+    void profile_reset();
+    void profile(isr_profile_t *profile);
+#endif
 
 private:
     int32                   _last_phase;
-    RingBuffer<int16>       _rbuf;
     timer_dev_num           _timer;
     uint8                   _channel;
     uint8                   _pin;
     uint8                   _state;
+    uint8                   _column;
+    volatile uint16         *_ccmr;
+    uint16                  _ocm_keep;
+    uint16                  _ocm_on;
+    uint16                  _ocm_off;
+#ifdef ISR_PROFILE
+    isr_profile_t           _profile;
+#endif
 };
 
+// Relative phases for all channels, one frame at a time
+extern FrameQueue<int8> PhaseQueue;
+
+// The ISR only ever uses a relative phase modulo 256 (see
+// TimerChannel::isr), so for any relative phase >= -384 the low byte
+// schedules exactly the same compare as the full value.  The phase
+// queue therefore stores one byte per channel.
+inline int8 pack_phase(int32 relative_phase)
+{
+    return (int8)(relative_phase & 0xFF);
+}
+
+void attach_tick(voidFuncPtr hook);
 void configure_timers(bool enable_uev = false);
 void start_timers();
 void stop_timers();
 void reset_timers();
-void set_prescale(bool sync=false);
-
-// Low level interrupts
-void timer2_ch1_interrupt(void);
-void timer2_ch2_interrupt(void);
-void timer2_ch3_interrupt(void);
-void timer2_ch4_interrupt(void);
-void timer3_ch1_interrupt(void);
-void timer3_ch2_interrupt(void);
-void timer3_ch3_interrupt(void);
-void timer3_ch4_interrupt(void);
-void timer4_ch1_interrupt(void);
-void timer4_ch2_interrupt(void);
-void timer4_ch3_interrupt(void);
-void timer4_ch4_interrupt(void);
+void timer_update();
+bool timer_update_done();
+void set_prescale_q16(uint32 prescale_q16);
+void set_frequency_millihz(uint32 millihz);
+void queue_stats_reset();
+void queue_stats_dump();
+void queue_stats_write();
+#ifdef ISR_PROFILE
+void isr_profile_reset();
+void isr_profile_dump();
+#endif
+#ifdef SPEED_LOCK
+void speed_lock_start();
+void speed_lock_poll();
+void speed_lock_stop();
+void speed_lock_dump();
+#endif
+
+// Low level interrupts, one set per timer configuration
+template <uint32 TC> void timer2_interrupt(void);
+template <uint32 TC> void timer3_interrupt(void);
+template <uint32 TC> void timer4_interrupt(void);
 
 #endif // __TIMERCONTROL_H__
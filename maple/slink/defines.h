@@ -5,11 +5,14 @@
 #define CHANNEL_COUNT           12
 #define PHASE_COUNT             1024
 #define PHASE_SCALE_FACTOR      4
-//#define TIMER_COUNT             (PHASE_COUNT * 32)
+#define TIMER_COUNT_SHOW        (PHASE_COUNT * 32)
+#define TIMER_COUNT_MAINTENANCE PHASE_COUNT
 #define BASE_FREQUENCY          50
 #define CLOCK_FREQUENCY         72000000
-#define MODE_COUNT              12 
-#define BUFFER_SIZE             400
+#define MODE_COUNT              8       // animation modes, see initMode()
+#define MODE_PARAM_COUNT        6
+#define BLEND_FRAMES            32      // frames to blend between steps, 0 cuts
+#define BUFFER_SIZE             800     // frames of lookahead
 #define PRELOAD_COUNT           (BUFFER_SIZE / 2)
 //#define MOTOR_MAX_SPEED         22500
 #define MOTOR_MAX_SPEED         390
@@ -27,6 +30,11 @@
 #define MAX_PRESCALE        ((unsigned int)(CLOCK_FREQUENCY / (PHASE_COUNT * (BASE_FREQUENCY - 2))))
 #define MIN_PRESCALE        ((unsigned int)(CLOCK_FREQUENCY / (PHASE_COUNT * (BASE_FREQUENCY + 2))))
 
+// The EEPROM emulation uses the last two 1k pages of flash, the show
+// sequence (see Sequence.h) lives in the page just below them.
+#define SEQUENCE_ADDRESS        0x0801F400
+#define SEQUENCE_PAGE_SIZE      0x400
+
 /* pins */
 #define MOTOR_PWM_PIN           7
 #define LED_PIN                 13
@@ -36,15 +44,43 @@
 #define BUTTON_STARTUP_PIN      34
 #define BUTTON_MAINTENANCE_PIN  33
 #define MOTOR_EN_PIN            36
+#define TACH_PIN                6       // rotor index, see SpeedLock.h
 
 //#define SERIAL_DEBUG
+// SerialUSB commands (any mode):
+//   s  queue statistics      S  same, as a binary status frame
+//   z  reset queue statistics
+//   u  upload a show sequence, see Sequence.h and maple/host/seqc
+//   l  run a live stream from the host instead of the show, see Stream.h
+//   k  speed lock state, with SPEED_LOCK
+// Measure ISR cost with the DWT cycle counter, dump it with 'p' over SerialUSB
+//#define ISR_PROFILE
+// Lock PRESCALE to the rotor from a tachometer index on TACH_PIN
+//#define SPEED_LOCK
+#define TACH_PHASE              0       // timer phase the index should land on
+
+// Binary status frames start with STATUS_FRAME_SYNC and a type byte
+#define STATUS_FRAME_SYNC           0xA5
+#define STATUS_FRAME_QUEUE_STATS    0x01    // see queue_stats_write()
+#define STATUS_FRAME_SEQUENCE       0x02    // see sequence_upload()
+#define STATUS_FRAME_STREAM_CREDIT  0x03    // see Stream.h
 
+#ifndef SLINK_HOST
 typedef unsigned int size_t;
+#endif
+
+// Orders memory accesses between the main loop and the ISRs.
+// On the Cortex-M3 this is a dmb, and it also stops the compiler from
+// moving loads and stores across it.
+#define memory_barrier()        __sync_synchronize()
 
+// One step of the show.  This is also the layout in flash and over
+// SerialUSB, see Sequence.h.
 typedef struct animation_info 
 {
-    int mode_number;
-    int duration;
+    uint8 mode_number;
+    uint8 duration;                     // in units of 256 frames
+    int16 param[MODE_PARAM_COUNT];      // see initMode()
 } animation_info_t;  
 
 const int ch_to_pin[] = {D2, D3, D1, D0, D12, D11, D27, D28, D5, D9, D14, D24};